@@ -0,0 +1,204 @@
+//
+// Mono.Net.Sockets.SocketBufferPool
+//
+// Buffers for socket I/O which live outside of the GC heap, so they don't
+// need to be pinned, and large sends from them can be done without copying.
+//
+
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+// 
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+using System;
+using System.Collections.Generic;
+using System.Net.Sockets;
+using System.Runtime.InteropServices;
+
+namespace Mono.Net.Sockets {
+
+	public static class SocketBufferPool {
+		// The largest segment the runtime hands out
+		public const int MaxSegmentSize = 64 * 1024;
+
+		public static SocketBufferSegment Alloc (int size)
+		{
+			if (size <= 0 || size > MaxSegmentSize)
+				throw new ArgumentOutOfRangeException ("size");
+
+			IntPtr data;
+			int capacity;
+			uint generation;
+			IntPtr handle = Socket.AllocSegment (size, out data, out capacity, out generation);
+			if (handle == IntPtr.Zero)
+				throw new OutOfMemoryException ();
+			return new SocketBufferSegment (handle, generation, data, capacity);
+		}
+
+		// Large sends on blocking sockets use MSG_ZEROCOPY where the kernel supports
+		// it, the segments can be freed or reused right away nonetheless.
+		public static int Send (Socket socket, IList<SocketBufferRange> buffers, SocketFlags socketFlags)
+		{
+			SocketError error;
+			int ret = Send (socket, buffers, socketFlags, out error);
+			if (error != SocketError.Success)
+				throw new SocketException ((int) error);
+			return ret;
+		}
+
+		public static int Send (Socket socket, IList<SocketBufferRange> buffers, SocketFlags socketFlags, out SocketError errorCode)
+		{
+			if (socket == null)
+				throw new ArgumentNullException ("socket");
+			return socket.SendSegments (buffers, socketFlags, out errorCode);
+		}
+
+		public static int Receive (Socket socket, IList<SocketBufferRange> buffers, SocketFlags socketFlags)
+		{
+			SocketError error;
+			int ret = Receive (socket, buffers, socketFlags, out error);
+			if (error != SocketError.Success)
+				throw new SocketException ((int) error);
+			return ret;
+		}
+
+		public static int Receive (Socket socket, IList<SocketBufferRange> buffers, SocketFlags socketFlags, out SocketError errorCode)
+		{
+			if (socket == null)
+				throw new ArgumentNullException ("socket");
+			return socket.ReceiveSegments (buffers, socketFlags, out errorCode);
+		}
+	}
+
+	public sealed class SocketBufferSegment : IDisposable {
+		IntPtr handle;
+		uint generation;
+		IntPtr address;
+		int length;
+
+		internal SocketBufferSegment (IntPtr handle, uint generation, IntPtr address, int length)
+		{
+			this.handle = handle;
+			this.generation = generation;
+			this.address = address;
+			this.length = length;
+		}
+
+		~SocketBufferSegment ()
+		{
+			Dispose (false);
+		}
+
+		internal IntPtr Handle {
+			get {
+				CheckDisposed ();
+				return handle;
+			}
+		}
+
+		// Lets the runtime reject the handle once the segment was freed and handed out again
+		internal uint Generation {
+			get { return generation; }
+		}
+
+		public IntPtr Address {
+			get {
+				CheckDisposed ();
+				return address;
+			}
+		}
+
+		// This might be larger than the requested size
+		public int Length {
+			get { return length; }
+		}
+
+		public void CopyFrom (byte [] source, int sourceOffset, int offset, int count)
+		{
+			CheckRange (offset, count);
+			Marshal.Copy (source, sourceOffset, new IntPtr (Address.ToInt64 () + offset), count);
+		}
+
+		public void CopyTo (int offset, byte [] destination, int destinationOffset, int count)
+		{
+			CheckRange (offset, count);
+			Marshal.Copy (new IntPtr (Address.ToInt64 () + offset), destination, destinationOffset, count);
+		}
+
+		public void Dispose ()
+		{
+			Dispose (true);
+			GC.SuppressFinalize (this);
+		}
+
+		void Dispose (bool disposing)
+		{
+			// The runtime keeps the memory alive until the sends and receives using it complete
+			IntPtr h = System.Threading.Interlocked.Exchange (ref handle, IntPtr.Zero);
+			if (h != IntPtr.Zero)
+				Socket.FreeSegment (h);
+		}
+
+		void CheckDisposed ()
+		{
+			if (handle == IntPtr.Zero)
+				throw new ObjectDisposedException (GetType ().ToString ());
+		}
+
+		void CheckRange (int offset, int count)
+		{
+			if (offset < 0 || count < 0 || count > length - offset)
+				throw new ArgumentOutOfRangeException ("offset");
+		}
+	}
+
+	public struct SocketBufferRange {
+		SocketBufferSegment segment;
+		int offset;
+		int count;
+
+		public SocketBufferRange (SocketBufferSegment segment)
+			: this (segment, 0, segment == null ? 0 : segment.Length)
+		{
+		}
+
+		public SocketBufferRange (SocketBufferSegment segment, int offset, int count)
+		{
+			if (segment == null)
+				throw new ArgumentNullException ("segment");
+			if (offset < 0 || count < 0 || count > segment.Length - offset)
+				throw new ArgumentOutOfRangeException ("offset");
+			this.segment = segment;
+			this.offset = offset;
+			this.count = count;
+		}
+
+		public SocketBufferSegment Segment {
+			get { return segment; }
+		}
+
+		public int Offset {
+			get { return offset; }
+		}
+
+		public int Count {
+			get { return count; }
+		}
+	}
+}
@@ -0,0 +1,112 @@
+//
+// System.Net.Sockets.Socket: I/O on Mono.Net.Sockets.SocketBufferPool segments
+//
+
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+// 
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+using System;
+using System.Collections.Generic;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using Mono.Net.Sockets;
+
+namespace System.Net.Sockets {
+
+	public partial class Socket {
+		[StructLayout (LayoutKind.Sequential)]
+		struct SegmentBuf {
+			public IntPtr segment;
+			public uint generation;
+			public int offset;
+			public int count;
+		}
+
+		[MethodImplAttribute (MethodImplOptions.InternalCall)]
+		extern static IntPtr AllocSegment_internal (int size, out IntPtr data, out int capacity, out uint generation);
+
+		[MethodImplAttribute (MethodImplOptions.InternalCall)]
+		extern static void FreeSegment_internal (IntPtr segment);
+
+		[MethodImplAttribute (MethodImplOptions.InternalCall)]
+		extern static int SendSegments_internal (IntPtr sock, SegmentBuf[] bufarray, SocketFlags flags, out int error);
+
+		[MethodImplAttribute (MethodImplOptions.InternalCall)]
+		extern static int ReceiveSegments_internal (IntPtr sock, SegmentBuf[] bufarray, SocketFlags flags, out int error);
+
+		internal static IntPtr AllocSegment (int size, out IntPtr data, out int capacity, out uint generation)
+		{
+			return AllocSegment_internal (size, out data, out capacity, out generation);
+		}
+
+		internal static void FreeSegment (IntPtr segment)
+		{
+			FreeSegment_internal (segment);
+		}
+
+		static SegmentBuf[] ToSegmentBufs (IList<SocketBufferRange> buffers)
+		{
+			if (buffers == null)
+				throw new ArgumentNullException ("buffers");
+			if (buffers.Count == 0)
+				throw new ArgumentException ("Buffer is empty", "buffers");
+
+			SegmentBuf[] bufarray = new SegmentBuf [buffers.Count];
+			for (int i = 0; i < bufarray.Length; i++) {
+				SocketBufferRange range = buffers [i];
+				if (range.Segment == null)
+					throw new ArgumentNullException ("buffers");
+				bufarray [i].segment = range.Segment.Handle;
+				bufarray [i].generation = range.Segment.Generation;
+				bufarray [i].offset = range.Offset;
+				bufarray [i].count = range.Count;
+			}
+			return bufarray;
+		}
+
+		internal int SendSegments (IList<SocketBufferRange> buffers, SocketFlags socketFlags, out SocketError errorCode)
+		{
+			if (disposed && closed)
+				throw new ObjectDisposedException (GetType ().ToString ());
+
+			SegmentBuf[] bufarray = ToSegmentBufs (buffers);
+			int nativeError;
+			int ret = SendSegments_internal (socket, bufarray, socketFlags, out nativeError);
+			// The segments must stay alive until the icall is done with them
+			GC.KeepAlive (buffers);
+			errorCode = (SocketError) nativeError;
+			return ret;
+		}
+
+		internal int ReceiveSegments (IList<SocketBufferRange> buffers, SocketFlags socketFlags, out SocketError errorCode)
+		{
+			if (disposed && closed)
+				throw new ObjectDisposedException (GetType ().ToString ());
+
+			SegmentBuf[] bufarray = ToSegmentBufs (buffers);
+			int nativeError;
+			int ret = ReceiveSegments_internal (socket, bufarray, socketFlags, out nativeError);
+			GC.KeepAlive (buffers);
+			errorCode = (SocketError) nativeError;
+			return ret;
+		}
+	}
+}
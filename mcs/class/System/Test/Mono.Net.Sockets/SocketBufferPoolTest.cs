@@ -0,0 +1,297 @@
+//
+// SocketBufferPoolTest.cs - NUnit tests for Mono.Net.Sockets.SocketBufferPool
+//
+
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#if !MOBILE
+
+using System;
+using System.Collections.Generic;
+using System.Net;
+using System.Net.Sockets;
+using System.Threading;
+using Mono.Net.Sockets;
+using NUnit.Framework;
+
+namespace MonoTests.Mono.Net.Sockets
+{
+	[TestFixture]
+	public class SocketBufferPoolTest
+	{
+		Socket client, server;
+
+		[SetUp]
+		public void SetUp ()
+		{
+			Socket listener = new Socket (AddressFamily.InterNetwork, SocketType.Stream, ProtocolType.Tcp);
+			try {
+				listener.Bind (new IPEndPoint (IPAddress.Loopback, 0));
+				listener.Listen (1);
+				client = new Socket (AddressFamily.InterNetwork, SocketType.Stream, ProtocolType.Tcp);
+				client.Connect (listener.LocalEndPoint);
+				server = listener.Accept ();
+			} finally {
+				listener.Close ();
+			}
+		}
+
+		[TearDown]
+		public void TearDown ()
+		{
+			if (client != null)
+				client.Close ();
+			if (server != null)
+				server.Close ();
+		}
+
+		static byte [] Pattern (int count, int seed)
+		{
+			byte [] data = new byte [count];
+			for (int i = 0; i < count; i++)
+				data [i] = (byte) (i * 7 + seed);
+			return data;
+		}
+
+		static IList<SocketBufferRange> Ranges (params SocketBufferRange [] ranges)
+		{
+			return ranges;
+		}
+
+		void ReceiveAll (SocketBufferSegment segment, int count)
+		{
+			int received = 0;
+			while (received < count) {
+				int ret = SocketBufferPool.Receive (server, Ranges (new SocketBufferRange (segment, received, count - received)), SocketFlags.None);
+				Assert.IsTrue (ret > 0, "#receive");
+				received += ret;
+			}
+		}
+
+		[Test]
+		public void Alloc ()
+		{
+			using (SocketBufferSegment segment = SocketBufferPool.Alloc (100)) {
+				Assert.IsTrue (segment.Length >= 100, "#1");
+				Assert.AreNotEqual (IntPtr.Zero, segment.Address, "#2");
+			}
+			using (SocketBufferSegment segment = SocketBufferPool.Alloc (SocketBufferPool.MaxSegmentSize))
+				Assert.AreEqual (SocketBufferPool.MaxSegmentSize, segment.Length, "#3");
+		}
+
+		[Test]
+		[ExpectedException (typeof (ArgumentOutOfRangeException))]
+		public void Alloc_Zero ()
+		{
+			SocketBufferPool.Alloc (0);
+		}
+
+		[Test]
+		[ExpectedException (typeof (ArgumentOutOfRangeException))]
+		public void Alloc_TooLarge ()
+		{
+			SocketBufferPool.Alloc (SocketBufferPool.MaxSegmentSize + 1);
+		}
+
+		[Test]
+		public void SendReceive ()
+		{
+			byte [] data = Pattern (1000, 1);
+			byte [] result = new byte [data.Length];
+
+			using (SocketBufferSegment send = SocketBufferPool.Alloc (data.Length))
+			using (SocketBufferSegment recv = SocketBufferPool.Alloc (data.Length)) {
+				send.CopyFrom (data, 0, 0, data.Length);
+				// Two ranges of the same segment, sent as one gather write
+				int sent = SocketBufferPool.Send (client, Ranges (new SocketBufferRange (send, 0, 400), new SocketBufferRange (send, 400, 600)), SocketFlags.None);
+				Assert.AreEqual (data.Length, sent, "#1");
+
+				ReceiveAll (recv, data.Length);
+				recv.CopyTo (0, result, 0, result.Length);
+				Assert.AreEqual (data, result, "#2");
+			}
+		}
+
+		[Test]
+		public void SendReceive_Large ()
+		{
+			// Large enough to take the zero copy path where the kernel supports it
+			int size = SocketBufferPool.MaxSegmentSize;
+			byte [] data = Pattern (size, 3);
+			byte [] result = new byte [size];
+
+			using (SocketBufferSegment recv = SocketBufferPool.Alloc (size)) {
+				SocketBufferSegment send = SocketBufferPool.Alloc (size);
+				send.CopyFrom (data, 0, 0, size);
+
+				Thread sender = new Thread (delegate () {
+					SocketBufferPool.Send (client, Ranges (new SocketBufferRange (send)), SocketFlags.None);
+					// Freeing right away must not affect the data being sent
+					send.Dispose ();
+					using (SocketBufferSegment other = SocketBufferPool.Alloc (size))
+						other.CopyFrom (new byte [size], 0, 0, size);
+				});
+				sender.Start ();
+
+				ReceiveAll (recv, size);
+				Assert.IsTrue (sender.Join (10000), "#1");
+				recv.CopyTo (0, result, 0, size);
+				Assert.AreEqual (data, result, "#2");
+			}
+		}
+
+		[Test]
+		public void Range_Bounds ()
+		{
+			using (SocketBufferSegment segment = SocketBufferPool.Alloc (100)) {
+				try {
+					new SocketBufferRange (segment, -1, 1);
+					Assert.Fail ("#1");
+				} catch (ArgumentOutOfRangeException) {
+				}
+				try {
+					new SocketBufferRange (segment, 0, segment.Length + 1);
+					Assert.Fail ("#2");
+				} catch (ArgumentOutOfRangeException) {
+				}
+				try {
+					new SocketBufferRange (segment, segment.Length, 1);
+					Assert.Fail ("#3");
+				} catch (ArgumentOutOfRangeException) {
+				}
+				try {
+					new SocketBufferRange (segment, 1, Int32.MaxValue);
+					Assert.Fail ("#4");
+				} catch (ArgumentOutOfRangeException) {
+				}
+				try {
+					segment.CopyFrom (new byte [10], 0, segment.Length - 5, 10);
+					Assert.Fail ("#5");
+				} catch (ArgumentOutOfRangeException) {
+				}
+
+				// Empty ranges at the end are fine
+				new SocketBufferRange (segment, segment.Length, 0);
+			}
+		}
+
+		[Test]
+		public void Range_NullSegment ()
+		{
+			try {
+				new SocketBufferRange (null, 0, 0);
+				Assert.Fail ("#1");
+			} catch (ArgumentNullException) {
+			}
+			try {
+				SocketBufferPool.Send (client, Ranges (new SocketBufferRange ()), SocketFlags.None);
+				Assert.Fail ("#2");
+			} catch (ArgumentNullException) {
+			}
+		}
+
+		[Test]
+		public void Disposed ()
+		{
+			SocketBufferSegment segment = SocketBufferPool.Alloc (100);
+			SocketBufferRange range = new SocketBufferRange (segment);
+			segment.Dispose ();
+			// Disposing twice is harmless
+			segment.Dispose ();
+
+			try {
+				IntPtr address = segment.Address;
+				Assert.Fail ("#1");
+			} catch (ObjectDisposedException) {
+			}
+			try {
+				SocketBufferPool.Send (client, Ranges (range), SocketFlags.None);
+				Assert.Fail ("#2");
+			} catch (ObjectDisposedException) {
+			}
+			try {
+				SocketBufferPool.Receive (server, Ranges (range), SocketFlags.None);
+				Assert.Fail ("#3");
+			} catch (ObjectDisposedException) {
+			}
+		}
+
+		[Test]
+		public void DisposeWhileReceiving ()
+		{
+			const int size = 1000;
+			SocketBufferSegment recv = SocketBufferPool.Alloc (size);
+			IntPtr recvAddress = recv.Address;
+			int received = -1;
+			Exception error = null;
+
+			Thread receiver = new Thread (delegate () {
+				try {
+					received = SocketBufferPool.Receive (server, Ranges (new SocketBufferRange (recv)), SocketFlags.None);
+				} catch (Exception e) {
+					error = e;
+				}
+			});
+			receiver.Start ();
+			// Give the receive time to block in the runtime
+			Thread.Sleep (500);
+
+			recv.Dispose ();
+
+			// The busy segment must not be handed out again while the receive uses it
+			List<SocketBufferSegment> others = new List<SocketBufferSegment> ();
+			byte [] pattern = Pattern (size, 5);
+			try {
+				for (int i = 0; i < 64; i++) {
+					SocketBufferSegment other = SocketBufferPool.Alloc (size);
+					others.Add (other);
+					Assert.AreNotEqual (recvAddress, other.Address, "#1");
+					other.CopyFrom (pattern, 0, 0, size);
+				}
+
+				byte [] data = Pattern (size, 9);
+				using (SocketBufferSegment send = SocketBufferPool.Alloc (size)) {
+					send.CopyFrom (data, 0, 0, size);
+					SocketBufferPool.Send (client, Ranges (new SocketBufferRange (send)), SocketFlags.None);
+				}
+				Assert.IsTrue (receiver.Join (10000), "#2");
+				Assert.IsNull (error, "#3");
+				Assert.IsTrue (received > 0, "#3b");
+
+				byte [] result = new byte [size];
+				foreach (SocketBufferSegment other in others) {
+					other.CopyTo (0, result, 0, size);
+					Assert.AreEqual (pattern, result, "#4");
+				}
+			} finally {
+				foreach (SocketBufferSegment other in others)
+					other.Dispose ();
+			}
+
+			// Once the receive returned, the segment is reused
+			using (SocketBufferSegment again = SocketBufferPool.Alloc (size))
+				Assert.AreNotEqual (IntPtr.Zero, again.Address, "#5");
+		}
+	}
+}
+
+#endif
@@ -33,6 +33,8 @@ class MakeBundle {
 	static string style = "linux";
 	static bool compress;
 	static bool nomain;
+	static bool mmap;
+	static string runtime = null;
 	
 	static int Main (string [] args)
 	{
@@ -124,6 +126,16 @@ class MakeBundle {
 			case "--nomain":
 				nomain = true;
 				break;
+			case "--mmap":
+				mmap = true;
+				break;
+			case "--runtime":
+				if (i+1 == top) {
+					Help ();
+					return 1;
+				}
+				runtime = args [++i];
+				break;
 			case "--style":
 				if (i+1 == top) {
 					Help ();
@@ -152,6 +164,11 @@ class MakeBundle {
 			}
 		}
 
+		if (mmap && (compress || static_link || compile_only || nomain || config_file != null || machine_config_file != null || config_dir != null)) {
+			Console.Error.WriteLine ("--mmap can not be combined with -z, -c, --static, --nomain or the config options");
+			return 1;
+		}
+
 		Console.WriteLine ("Sources: {0} Auto-dependencies: {1}", sources.Count, autodeps);
 		if (sources.Count == 0 || output == null) {
 			Help ();
@@ -180,7 +197,10 @@ class MakeBundle {
 			}
 		}
 
-		GenerateBundles (files);
+		if (mmap)
+			GenerateMappedBundle (files);
+		else
+			GenerateBundles (files);
 		//GenerateJitWrapper ();
 		
 		return 0;
@@ -466,6 +486,75 @@ class MakeBundle {
 		}
 	}
 	
+	//
+	// Appends the assemblies to a copy of the runtime executable, each one
+	// starting at a 64k boundary, followed by an index and a trailer. 64k is
+	// a multiple of the page size of all the systems we run on. The
+	// runtime finds them at startup and maps them in place, so the pages are
+	// shared between all the processes running the bundle. The format is
+	// described next to mono_register_bundled_assemblies_from_file () in
+	// mono/metadata/assembly.c.
+	//
+	static void GenerateMappedBundle (ArrayList files)
+	{
+		const int alignment = 65536;
+		string runtime_file = runtime != null ? runtime : Process.GetCurrentProcess ().MainModule.FileName;
+		ArrayList names = new ArrayList ();
+		ArrayList offsets = new ArrayList ();
+		ArrayList sizes = new ArrayList ();
+		byte [] buffer = new byte [8192];
+		int n;
+
+		Console.WriteLine ("Runtime from: " + runtime_file);
+		File.Copy (runtime_file, output, true);
+
+		using (FileStream fs = File.Open (output, FileMode.Open, FileAccess.Write)) {
+			fs.Seek (0, SeekOrigin.End);
+
+			foreach (string url in files){
+				string fname = new Uri (url).LocalPath;
+
+				Console.WriteLine ("   embedding: " + fname);
+
+				long pad = (alignment - fs.Position % alignment) % alignment;
+				fs.Write (new byte [pad], 0, (int) pad);
+
+				names.Add (Path.GetFileName (fname));
+				offsets.Add (fs.Position);
+				using (Stream stream = File.OpenRead (fname)) {
+					while ((n = stream.Read (buffer, 0, buffer.Length)) != 0)
+						fs.Write (buffer, 0, n);
+					sizes.Add (stream.Length);
+				}
+			}
+
+			BinaryWriter bw = new BinaryWriter (fs);
+			long index_offset = fs.Position;
+			for (int i = 0; i < names.Count; i++) {
+				byte [] name = Encoding.UTF8.GetBytes ((string) names [i]);
+
+				bw.Write ((long) offsets [i]);
+				bw.Write ((long) sizes [i]);
+				bw.Write (name.Length);
+				bw.Write (name);
+			}
+			bw.Flush ();
+			int index_size = (int) (fs.Position - index_offset);
+
+			bw.Write (index_offset);
+			bw.Write (index_size);
+			bw.Write (names.Count);
+			bw.Write (Encoding.ASCII.GetBytes ("MBUNDLE1"));
+			bw.Flush ();
+		}
+
+		if (IsUnix) {
+			UnixFileInfo info = new UnixFileInfo (output);
+			info.FileAccessPermissions |= FileAccessPermissions.UserExecute | FileAccessPermissions.GroupExecute | FileAccessPermissions.OtherExecute;
+		}
+		Console.WriteLine ("Done");
+	}
+
 	static ArrayList LoadAssemblies (ArrayList sources)
 	{
 		ArrayList assemblies = new ArrayList ();
@@ -572,7 +661,10 @@ class MakeBundle {
 				   "    --static            Statically link to mono libs\n" +
 				   "    --nomain            Don't include a main() function, for libraries\n" +
 				   "    -z                  Compress the assemblies before embedding.\n" +
-				   "                        You need zlib development headers and libraries.\n");
+				   "                        You need zlib development headers and libraries.\n" +
+				   "    --mmap              Append the assemblies to a copy of the runtime, from\n" +
+				   "                        where they are mapped in place, no C compiler is needed.\n" +
+				   "    --runtime F         Use `F' as the runtime executable for --mmap.\n");
 	}
 
 	[DllImport ("libc")]
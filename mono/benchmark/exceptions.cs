@@ -0,0 +1,49 @@
+using System;
+
+//
+// Throws exceptions through a few frames and catches them, the way code
+// using exceptions for control flow does, so most of the time is spent
+// unwinding the stack and capturing the stack trace.
+//
+class T {
+	class ParseException : Exception {
+		public ParseException (string msg) : base (msg) {
+		}
+	}
+
+	static int Parse (string s, int depth) {
+		if (depth > 0)
+			return Parse (s, depth - 1) + 1;
+		throw new ParseException (s);
+	}
+
+	static int Try (string s, int depth) {
+		try {
+			return Parse (s, depth);
+		} catch (ParseException) {
+			return -1;
+		} finally {
+			depth = 0;
+		}
+	}
+
+	static int Main (string[] args) {
+		int repeat = 100000;
+		int depth = 5;
+
+		if (args.Length > 0)
+			repeat = Convert.ToInt32 (args [0]);
+		if (args.Length > 1)
+			depth = Convert.ToInt32 (args [1]);
+
+		int start = Environment.TickCount;
+		int n = 0;
+
+		for (int i = 0; i < repeat; i++)
+			n += Try ("x", depth);
+
+		int elapsed = Environment.TickCount - start;
+		Console.WriteLine ("{0} throws, depth {1}: {2} ms ({3} us/throw)", -n, depth, elapsed, (elapsed * 1000.0) / repeat);
+		return 0;
+	}
+}
@@ -0,0 +1,74 @@
+using System;
+using System.Collections.Generic;
+using System.Threading;
+
+//
+// Instantiates many generic types from several threads at once, and then
+// keeps allocating them, so most of the time is spent looking up vtables
+// which already exist.
+//
+class T {
+	struct S1 { public int a; }
+	struct S2 { public long a; }
+	struct S3 { public double a; }
+	struct S4 { public byte a; }
+
+	static Type[] args = new Type[] {
+		typeof (int), typeof (long), typeof (short), typeof (byte),
+		typeof (uint), typeof (ulong), typeof (ushort), typeof (sbyte),
+		typeof (float), typeof (double), typeof (char), typeof (bool),
+		typeof (string), typeof (object), typeof (S1), typeof (S2),
+		typeof (S3), typeof (S4), typeof (DateTime), typeof (TimeSpan),
+		typeof (Guid), typeof (decimal), typeof (IntPtr), typeof (Version)
+	};
+
+	static Type[] defs = new Type[] {
+		typeof (List<>), typeof (Queue<>), typeof (Stack<>), typeof (HashSet<>),
+		typeof (LinkedList<>), typeof (Dictionary<,>), typeof (SortedList<,>),
+		typeof (KeyValuePair<,>), typeof (Nullable<>)
+	};
+
+	static int iterations = 200;
+
+	static void Work () {
+		for (int n = 0; n < iterations; n++) {
+			foreach (Type def in defs) {
+				foreach (Type a in args) {
+					Type t;
+
+					try {
+						if (def.GetGenericArguments ().Length == 2)
+							t = def.MakeGenericType (a, a);
+						else
+							t = def.MakeGenericType (a);
+					} catch (ArgumentException) {
+						/* Nullable<T> of a reference type */
+						continue;
+					}
+					Activator.CreateInstance (t);
+				}
+			}
+		}
+	}
+
+	static int Main (string[] args) {
+		int nthreads = Environment.ProcessorCount;
+
+		if (args.Length > 0)
+			nthreads = Convert.ToInt32 (args [0]);
+		if (args.Length > 1)
+			iterations = Convert.ToInt32 (args [1]);
+
+		int start = Environment.TickCount;
+		Thread[] threads = new Thread [nthreads];
+		for (int i = 0; i < nthreads; i++) {
+			threads [i] = new Thread (Work);
+			threads [i].Start ();
+		}
+		foreach (Thread t in threads)
+			t.Join ();
+
+		Console.WriteLine ("{0} threads: {1} ms", nthreads, Environment.TickCount - start);
+		return 0;
+	}
+}
@@ -0,0 +1,72 @@
+using System;
+using System.Collections.Generic;
+
+//
+// Runs Dictionary<TKey,TValue> and List<T> over reference type arguments,
+// so all of the work happens in shared generic code which has to fetch
+// its types and methods from the runtime generic context.
+//
+class T {
+	class K {
+		public int v;
+
+		public K (int v) {
+			this.v = v;
+		}
+
+		public override int GetHashCode () {
+			return v;
+		}
+
+		public override bool Equals (object o) {
+			K k = o as K;
+			return k != null && k.v == v;
+		}
+	}
+
+	static int Fill<TKey, TValue> (TKey[] keys, TValue val) where TValue : class {
+		Dictionary<TKey, TValue> d = new Dictionary<TKey, TValue> ();
+		List<TValue> l = new List<TValue> ();
+		int n = 0;
+
+		foreach (TKey k in keys)
+			d [k] = val;
+		foreach (TKey k in keys) {
+			TValue v;
+			if (d.TryGetValue (k, out v)) {
+				l.Add (v);
+				n++;
+			}
+		}
+		foreach (KeyValuePair<TKey, TValue> kv in d)
+			if (kv.Value != null)
+				n++;
+		return n + l.Count;
+	}
+
+	static int Main (string[] args) {
+		int repeat = 200;
+
+		if (args.Length == 1)
+			repeat = Convert.ToInt32 (args [0]);
+
+		K[] keys = new K [1000];
+		string[] skeys = new string [1000];
+		for (int i = 0; i < keys.Length; i++) {
+			keys [i] = new K (i);
+			skeys [i] = i.ToString ();
+		}
+
+		int start = Environment.TickCount;
+		int n = 0;
+
+		for (int i = 0; i < repeat; i++) {
+			n += Fill<K, string> (keys, "a");
+			n += Fill<string, K> (skeys, keys [0]);
+			n += Fill<K, object> (keys, keys);
+		}
+
+		Console.WriteLine ("{0} items, {1} ms", n, Environment.TickCount - start);
+		return 0;
+	}
+}
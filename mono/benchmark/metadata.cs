@@ -0,0 +1,49 @@
+using System;
+using System.Reflection;
+
+//
+// Exercises the sorted metadata table lookups (CustomAttribute,
+// MethodSemantics, NestedClass, InterfaceImpl, GenericParam) over every
+// type in mscorlib.
+//
+class T {
+	const BindingFlags all = BindingFlags.Public | BindingFlags.NonPublic |
+		BindingFlags.Instance | BindingFlags.Static | BindingFlags.DeclaredOnly;
+
+	static int Walk (Type[] types) {
+		int n = 0;
+
+		foreach (Type t in types) {
+			n += t.GetCustomAttributes (false).Length;
+			n += t.GetInterfaces ().Length;
+			n += t.GetNestedTypes (all).Length;
+			if (t.IsGenericTypeDefinition)
+				n += t.GetGenericArguments ().Length;
+			foreach (PropertyInfo p in t.GetProperties (all))
+				n += p.GetAccessors (true).Length;
+			foreach (EventInfo e in t.GetEvents (all))
+				if (e.GetAddMethod (true) != null)
+					n++;
+			if (t.DeclaringType != null)
+				n++;
+		}
+		return n;
+	}
+
+	static int Main (string[] args) {
+		int repeat = 10;
+
+		if (args.Length == 1)
+			repeat = Convert.ToInt32 (args [0]);
+
+		Type[] types = typeof (object).Assembly.GetTypes ();
+		int start = Environment.TickCount;
+		int n = 0;
+
+		for (int i = 0; i < repeat; i++)
+			n += Walk (types);
+
+		Console.WriteLine ("{0} types, {1} items, {2} ms", types.Length, n, Environment.TickCount - start);
+		return 0;
+	}
+}
@@ -21,6 +21,7 @@
 #include <mono/io-layer/misc-private.h>
 #include <mono/io-layer/collection.h>
 #include <mono/io-layer/shared.h>
+#include <mono/utils/mono-membar.h>
 
 #define _WAPI_PRIVATE_MAX_SLOTS		(1024 * 16)
 #define _WAPI_PRIVATE_HANDLES(x) (_wapi_private_handles [x / _WAPI_HANDLE_INITIAL_COUNT][x % _WAPI_HANDLE_INITIAL_COUNT])
@@ -37,6 +38,7 @@ extern struct _WapiFileShareLayout *_wapi_fileshare_layout;
 extern guint32 _wapi_fd_reserve;
 extern mono_mutex_t *_wapi_global_signal_mutex;
 extern pthread_cond_t *_wapi_global_signal_cond;
+extern volatile gint32 _wapi_global_signal_waiters;
 extern int _wapi_sem_id;
 extern gboolean _wapi_has_shut_down;
 
@@ -141,15 +143,6 @@ static inline void _wapi_handle_set_signal_state (gpointer handle,
 	if (state == TRUE) {
 		/* Tell everyone blocking on a single handle */
 
-		/* The condition the global signal cond is waiting on is the signalling of
-		 * _any_ handle. So lock it before setting the signalled state.
-		 */
-		pthread_cleanup_push ((void(*)(void *))mono_mutex_unlock_in_cleanup, (void *)_wapi_global_signal_mutex);
-		thr_ret = mono_mutex_lock (_wapi_global_signal_mutex);
-		if (thr_ret != 0)
-			g_warning ("Bad call to mono_mutex_lock result %d for global signal mutex", thr_ret);
-		g_assert (thr_ret == 0);
-
 		/* This function _must_ be called with
 		 * handle->signal_mutex locked
 		 */
@@ -168,8 +161,23 @@ static inline void _wapi_handle_set_signal_state (gpointer handle,
 		}
 
 		/* Tell everyone blocking on multiple handles that something
-		 * was signalled
-		 */			
+		 * was signalled.  Only WaitForMultipleObjectsEx () waits on
+		 * the global signal cond, and it registers itself in
+		 * _wapi_global_signal_waiters before checking the handle
+		 * states, so if the barrier below shows no waiters, any
+		 * later check is bound to see the new state and we can skip
+		 * the global mutex altogether.
+		 */
+		mono_memory_barrier ();
+		if (_wapi_global_signal_waiters == 0)
+			return;
+
+		pthread_cleanup_push ((void(*)(void *))mono_mutex_unlock_in_cleanup, (void *)_wapi_global_signal_mutex);
+		thr_ret = mono_mutex_lock (_wapi_global_signal_mutex);
+		if (thr_ret != 0)
+			g_warning ("Bad call to mono_mutex_lock result %d for global signal mutex", thr_ret);
+		g_assert (thr_ret == 0);
+
 		thr_ret = pthread_cond_broadcast (_wapi_global_signal_cond);
 		if (thr_ret != 0)
 			g_warning ("Bad call to pthread_cond_broadcast result %d for handle %p", thr_ret, handle);
@@ -147,6 +147,8 @@ static gpointer _wapi_global_signal_handle;
 /* Point to the mutex/cond inside _wapi_global_signal_handle */
 mono_mutex_t *_wapi_global_signal_mutex;
 pthread_cond_t *_wapi_global_signal_cond;
+/* Number of threads inside the global signal mutex in WaitForMultipleObjectsEx () */
+volatile gint32 _wapi_global_signal_waiters;
 
 int _wapi_sem_id;
 gboolean _wapi_has_shut_down = FALSE;
@@ -175,6 +177,25 @@ pid_t _wapi_getpid (void)
 
 static mono_mutex_t scan_mutex = MONO_MUTEX_INITIALIZER;
 
+/*
+ * Indexes of destroyed (non fd) handles, so _wapi_handle_new_internal ()
+ * can reuse them without scanning the whole table.  Protected by
+ * scan_mutex.
+ */
+static guint32 *free_handles;
+static guint32 free_handles_count;
+static guint32 free_handles_size;
+
+static void
+push_free_handle (guint32 idx)
+{
+	if (free_handles_count == free_handles_size) {
+		free_handles_size = free_handles_size ? free_handles_size * 2 : _WAPI_HANDLE_INITIAL_COUNT;
+		free_handles = g_renew (guint32, free_handles, free_handles_size);
+	}
+	free_handles [free_handles_count++] = idx;
+}
+
 static void handle_cleanup (void)
 {
 	int i, j, k;
@@ -411,8 +432,20 @@ static guint32 _wapi_handle_new_internal (WapiHandleType type,
 	gboolean retry = FALSE;
 	
 	g_assert (_wapi_has_shut_down == FALSE);
-	
-	/* A linear scan should be fast enough.  Start from the last
+
+	/* Reuse the most recently destroyed handle if there is one.  An
+	 * entry might have been picked up by the scan below in the
+	 * meantime, so check it's still unused.
+	 */
+	while (free_handles_count > 0) {
+		count = free_handles [--free_handles_count];
+		if (_WAPI_PRIVATE_HANDLES (count).type == WAPI_HANDLE_UNUSED) {
+			_wapi_handle_init (&_WAPI_PRIVATE_HANDLES (count), type, handle_specific);
+			return (count);
+		}
+	}
+
+	/* Otherwise do a linear scan.  Start from the last
 	 * allocation, assuming that handles are allocated more often
 	 * than they're freed. Leave the space reserved for file
 	 * descriptors
@@ -1089,6 +1122,9 @@ static void _wapi_handle_unref_full (gpointer handle, gboolean ignore_private_bu
 			sizeof(_WAPI_PRIVATE_HANDLES(idx).u));
 
 		_WAPI_PRIVATE_HANDLES(idx).type = WAPI_HANDLE_UNUSED;
+
+		if (!_WAPI_FD_HANDLE (type))
+			push_free_handle (idx);
 		
 		if (!is_shared) {
 			/* Destroy the mutex and cond var.  We hope nobody
@@ -22,6 +22,12 @@ struct _WapiHandle_socket
 	int protocol;
 	int saved_error;
 	int still_readable;
+	/* 0 if not tried yet, 1 if SO_ZEROCOPY is enabled, -1 if it is not supported */
+	int zerocopy;
+	/* Set while a zero copy send is in progress */
+	gint32 zerocopy_busy;
+	/* The id the kernel will give to the next zero copy send */
+	guint32 zerocopy_next_id;
 };
 
 #endif /* _WAPI_SOCKET_PRIVATE_H_ */
@@ -50,6 +50,22 @@
 #ifdef HAVE_SYS_SENDFILE_H
 #include <sys/sendfile.h>
 #endif
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+
+#ifdef __linux__
+/* These are only defined by recent headers */
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#endif
 
 #if 0
 #define DEBUG(...) g_message(__VA_ARGS__)
@@ -1085,11 +1101,115 @@ static gboolean wapi_disconnectex (guint32 fd, WapiOverlapped *overlapped,
 }
 
 #define SF_BUFFER_SIZE	16384
+
+#if !defined(HAVE_SENDFILE) || !defined(DARWIN)
+static gboolean
+wapi_sendfile_wait_writable (guint32 socket)
+{
+	mono_pollfd pfd;
+
+	pfd.fd = socket;
+	pfd.events = MONO_POLLOUT;
+	pfd.revents = 0;
+	while (mono_poll (&pfd, 1, -1) == -1) {
+		if (errno != EINTR || _wapi_thread_cur_apc_pending ())
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Copies the rest of @file to @socket through a buffer. Used where there is no
+ * sendfile () and for files the kernel can't sendfile () from.
+ */
+static gint
+wapi_sendfile_copy (guint32 socket, gint file)
+{
+	gchar *buffer;
+	gint n, sent, res;
+	gint errnum;
+
+	buffer = g_malloc (SF_BUFFER_SIZE);
+	do {
+		do {
+			n = read (file, buffer, SF_BUFFER_SIZE);
+		} while (n == -1 && errno == EINTR && !_wapi_thread_cur_apc_pending ());
+
+		for (sent = 0; n > 0 && sent < n; sent += res) {
+			do {
+				res = send (socket, buffer + sent, n - sent, 0);
+			} while (res == -1 && errno == EINTR && !_wapi_thread_cur_apc_pending ());
+
+			if (res == -1 && errno == EAGAIN && wapi_sendfile_wait_writable (socket))
+				res = 0;
+			else if (res == -1)
+				n = -1;
+		}
+	} while (n > 0);
+
+	if (n == -1) {
+		errnum = errno;
+		g_free (buffer);
+		errnum = errno_to_WSA (errnum, __func__);
+		WSASetLastError (errnum);
+		return SOCKET_ERROR;
+	}
+
+	g_free (buffer);
+	return 0;
+}
+#endif
+
 static gint
 wapi_sendfile (guint32 socket, gpointer fd, guint32 bytes_to_write, guint32 bytes_per_send, guint32 flags)
 {
-#if defined(HAVE_SENDFILE) && (defined(__linux__) || defined(DARWIN))
 	gint file = GPOINTER_TO_INT (fd);
+#if defined(HAVE_SENDFILE) && defined(__linux__)
+	gint errnum;
+	gssize res;
+	off_t remaining;
+	gboolean started = FALSE;
+	struct stat statbuf;
+
+	if (fstat (file, &statbuf) == -1) {
+		errnum = errno;
+		errnum = errno_to_WSA (errnum, __func__);
+		WSASetLastError (errnum);
+		return SOCKET_ERROR;
+	}
+
+	/*
+	 * sendfile () can return short counts (signals, non-blocking sockets, the
+	 * per-call size limit), so keep going until the whole file is in the socket.
+	 */
+	remaining = statbuf.st_size;
+	while (remaining > 0) {
+		do {
+			res = sendfile (socket, file, NULL, remaining);
+		} while (res == -1 && errno == EINTR && !_wapi_thread_cur_apc_pending ());
+
+		if (res == -1 && errno == EAGAIN && wapi_sendfile_wait_writable (socket))
+			continue;
+
+		/* Nothing sent yet and the file doesn't support sendfile () */
+		if (res == -1 && !started && (errno == EINVAL || errno == ENOSYS))
+			return wapi_sendfile_copy (socket, file);
+
+		if (res == -1) {
+			errnum = errno;
+			errnum = errno_to_WSA (errnum, __func__);
+			WSASetLastError (errnum);
+			return SOCKET_ERROR;
+		}
+
+		if (res == 0)
+			break; /* The file was truncated */
+
+		started = TRUE;
+		remaining -= res;
+	}
+	return 0;
+#elif defined(HAVE_SENDFILE) && defined(DARWIN)
 	gint n;
 	gint errnum;
 	gssize res;
@@ -1103,13 +1223,9 @@ wapi_sendfile (guint32 socket, gpointer fd, guint32 bytes_to_write, guint32 byte
 		return SOCKET_ERROR;
 	}
 	do {
-#ifdef __linux__
-		res = sendfile (socket, file, NULL, statbuf.st_size);
-#elif defined(DARWIN)
 		/* TODO: header/tail could be sent in the 5th argument */
 		/* TODO: Might not send the entire file for non-blocking sockets */
 		res = sendfile (file, socket, 0, &statbuf.st_size, NULL, 0);
-#endif
 	} while (res != -1 && (errno == EINTR || errno == EAGAIN) && !_wapi_thread_cur_apc_pending ());
 	if (res == -1) {
 		errnum = errno;
@@ -1117,38 +1233,10 @@ wapi_sendfile (guint32 socket, gpointer fd, guint32 bytes_to_write, guint32 byte
 		WSASetLastError (errnum);
 		return SOCKET_ERROR;
 	}
+	return 0;
 #else
-	/* Default implementation */
-	gint file = GPOINTER_TO_INT (fd);
-	gchar *buffer;
-	gint n;
-
-	buffer = g_malloc (SF_BUFFER_SIZE);
-	do {
-		do {
-			n = read (file, buffer, SF_BUFFER_SIZE);
-		} while (n == -1 && errno == EINTR && !_wapi_thread_cur_apc_pending ());
-		if (n == -1)
-			break;
-		if (n == 0) {
-			g_free (buffer);
-			return 0; /* We're done reading */
-		}
-		do {
-			n = send (socket, buffer, n, 0); /* short sends? enclose this in a loop? */
-		} while (n == -1 && errno == EINTR && !_wapi_thread_cur_apc_pending ());
-	} while (n != -1);
-
-	if (n == -1) {
-		gint errnum = errno;
-		errnum = errno_to_WSA (errnum, __func__);
-		WSASetLastError (errnum);
-		g_free (buffer);
-		return SOCKET_ERROR;
-	}
-	g_free (buffer);
+	return wapi_sendfile_copy (socket, file);
 #endif
-	return 0;
 }
 
 gboolean
@@ -1520,14 +1608,23 @@ void _wapi_FD_SET(guint32 fd, fd_set *set)
 }
 #endif
 
+/*
+ * Scatter/gather calls with up to this many buffers use an iovec array on
+ * the caller's stack instead of allocating one for every call.
+ */
+#define WSABUF_STACK_IOVECS 16
+
 static void
-wsabuf_to_msghdr (WapiWSABuf *buffers, guint32 count, struct msghdr *hdr)
+wsabuf_to_msghdr (WapiWSABuf *buffers, guint32 count, struct msghdr *hdr, struct iovec *stack_iov)
 {
 	guint32 i;
 
 	memset (hdr, 0, sizeof (struct msghdr));
 	hdr->msg_iovlen = count;
-	hdr->msg_iov = g_new0 (struct iovec, count);
+	if (count <= WSABUF_STACK_IOVECS)
+		hdr->msg_iov = stack_iov;
+	else
+		hdr->msg_iov = g_new0 (struct iovec, count);
 	for (i = 0; i < count; i++) {
 		hdr->msg_iov [i].iov_base = buffers [i].buf;
 		hdr->msg_iov [i].iov_len  = buffers [i].len;
@@ -1535,9 +1632,10 @@ wsabuf_to_msghdr (WapiWSABuf *buffers, guint32 count, struct msghdr *hdr)
 }
 
 static void
-msghdr_iov_free (struct msghdr *hdr)
+msghdr_iov_free (struct msghdr *hdr, struct iovec *stack_iov)
 {
-	g_free (hdr->msg_iov);
+	if (hdr->msg_iov != stack_iov)
+		g_free (hdr->msg_iov);
 }
 
 int WSARecv (guint32 fd, WapiWSABuf *buffers, guint32 count, guint32 *received,
@@ -1546,13 +1644,14 @@ int WSARecv (guint32 fd, WapiWSABuf *buffers, guint32 count, guint32 *received,
 {
 	int ret;
 	struct msghdr hdr;
+	struct iovec iov [WSABUF_STACK_IOVECS];
 
 	g_assert (overlapped == NULL);
 	g_assert (complete == NULL);
 
-	wsabuf_to_msghdr (buffers, count, &hdr);
+	wsabuf_to_msghdr (buffers, count, &hdr, iov);
 	ret = _wapi_recvmsg (fd, &hdr, *flags);
-	msghdr_iov_free (&hdr);
+	msghdr_iov_free (&hdr, iov);
 	
 	if(ret == SOCKET_ERROR) {
 		return(ret);
@@ -1570,13 +1669,14 @@ int WSASend (guint32 fd, WapiWSABuf *buffers, guint32 count, guint32 *sent,
 {
 	int ret;
 	struct msghdr hdr;
+	struct iovec iov [WSABUF_STACK_IOVECS];
 
 	g_assert (overlapped == NULL);
 	g_assert (complete == NULL);
 
-	wsabuf_to_msghdr (buffers, count, &hdr);
+	wsabuf_to_msghdr (buffers, count, &hdr, iov);
 	ret = _wapi_sendmsg (fd, &hdr, flags);
-	msghdr_iov_free (&hdr);
+	msghdr_iov_free (&hdr, iov);
 	
 	if(ret == SOCKET_ERROR) 
 		return ret;
@@ -1585,4 +1685,110 @@ int WSASend (guint32 fd, WapiWSABuf *buffers, guint32 count, guint32 *sent,
 	return 0;
 }
 
+/*
+ * wapi_send_zerocopy:
+ *
+ *   Same as WSASend (), but ask the kernel to send the data directly from BUFFERS
+ * using MSG_ZEROCOPY. In that case, the id of the send is stored into ID, and the
+ * buffers must not be modified or freed until wapi_zerocopy_completion () reports
+ * it as completed. If zero copy sends are not supported, or another one is in
+ * progress on this socket, the data is copied as usual and ID is set to -1.
+ */
+int
+wapi_send_zerocopy (guint32 fd, WapiWSABuf *buffers, guint32 count, guint32 *sent,
+		    guint32 flags, gint64 *id)
+{
+#ifdef __linux__
+	gpointer handle = GUINT_TO_POINTER (fd);
+	struct _WapiHandle_socket *socket_handle;
+	struct msghdr hdr;
+	struct iovec iov [WSABUF_STACK_IOVECS];
+	int ret, one = 1;
+#endif
+
+	*id = -1;
+
+#ifdef __linux__
+	if (startup_count == 0 || !_wapi_lookup_handle (handle, WAPI_HANDLE_SOCKET, (gpointer *)&socket_handle))
+		return WSASend (fd, buffers, count, sent, flags, NULL, NULL);
+
+	/*
+	 * The kernel numbers zero copy sends in the order it processes them, so two of them
+	 * can't race on the same socket, or their ids could be swapped.
+	 */
+	if (socket_handle->zerocopy == -1 || InterlockedCompareExchange (&socket_handle->zerocopy_busy, 1, 0) != 0)
+		return WSASend (fd, buffers, count, sent, flags, NULL, NULL);
+
+	if (socket_handle->zerocopy == 0)
+		socket_handle->zerocopy = setsockopt (fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof (one)) == 0 ? 1 : -1;
+
+	if (socket_handle->zerocopy == 1) {
+		wsabuf_to_msghdr (buffers, count, &hdr, iov);
+		ret = _wapi_sendmsg (fd, &hdr, flags | MSG_ZEROCOPY);
+		msghdr_iov_free (&hdr, iov);
+
+		if (ret != SOCKET_ERROR) {
+			*id = socket_handle->zerocopy_next_id ++;
+			*sent = ret;
+		}
+		InterlockedExchange (&socket_handle->zerocopy_busy, 0);
+
+		/* ENOBUFS means the pages couldn't be pinned, copy them instead */
+		if (ret != SOCKET_ERROR || WSAGetLastError () != WSAENOBUFS)
+			return ret == SOCKET_ERROR ? ret : 0;
+	} else {
+		InterlockedExchange (&socket_handle->zerocopy_busy, 0);
+	}
+#endif
+
+	return WSASend (fd, buffers, count, sent, flags, NULL, NULL);
+}
+
+/*
+ * wapi_zerocopy_completion:
+ *
+ *   Read a notification of completed zero copy sends from the error queue of the
+ * socket, without blocking. Return TRUE and store the range of ids of the sends
+ * into FIRST and LAST if there was one. Other errors queued by IP_RECVERR are
+ * discarded.
+ */
+gboolean
+wapi_zerocopy_completion (guint32 fd, guint32 *first, guint32 *last)
+{
+#ifdef __linux__
+	char control [128];
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	struct sock_extended_err *serr;
+	int ret;
+
+	while (TRUE) {
+		memset (&msg, 0, sizeof (msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof (control);
+
+		do {
+			ret = recvmsg (fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+		} while (ret == -1 && errno == EINTR);
+		if (ret == -1)
+			return FALSE;
+
+		for (cm = CMSG_FIRSTHDR (&msg); cm; cm = CMSG_NXTHDR (&msg, cm)) {
+			if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+			    !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+				continue;
+
+			serr = (struct sock_extended_err *)CMSG_DATA (cm);
+			if (serr->ee_errno == 0 && serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+				*first = serr->ee_info;
+				*last = serr->ee_data;
+				return TRUE;
+			}
+		}
+	}
+#endif
+
+	return FALSE;
+}
+
 #endif /* ifndef DISABLE_SOCKETS */
@@ -99,5 +99,10 @@ extern int WSASend (guint32 handle, WapiWSABuf *buffers, guint32 count,
 
 gboolean TransmitFile (guint32 socket, gpointer file, guint32 bytes_to_write, guint32 bytes_per_send, WapiOverlapped *ol,
 			WapiTransmitFileBuffers *tb, guint32 flags);
+
+/* Not part of winsock */
+extern int wapi_send_zerocopy (guint32 handle, WapiWSABuf *buffers, guint32 count,
+			       guint32 *sent, guint32 flags, gint64 *id);
+extern gboolean wapi_zerocopy_completion (guint32 handle, guint32 *first, guint32 *last);
 G_END_DECLS
 #endif /* _WAPI_SOCKETS_H_ */
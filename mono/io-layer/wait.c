@@ -648,6 +648,12 @@ guint32 WaitForMultipleObjectsEx(guint32 numobjects, gpointer *handles,
 		thr_ret = _wapi_handle_lock_signal_mutex ();
 		g_assert (thr_ret == 0);
 
+		/* Signallers skip the global cond unless they see us here,
+		 * so register before looking at the handles (the atomic
+		 * increment is a full barrier).
+		 */
+		InterlockedIncrement (&_wapi_global_signal_waiters);
+
 		/* Check the signalled state of handles inside the critical section */
 		if (waitall) {
 			done = TRUE;
@@ -673,6 +679,8 @@ guint32 WaitForMultipleObjectsEx(guint32 numobjects, gpointer *handles,
 			ret = 0;
 		}
 
+		InterlockedDecrement (&_wapi_global_signal_waiters);
+
 		DEBUG ("%s: unlocking signal mutex", __func__);
 
 		thr_ret = _wapi_handle_unlock_signal_mutex (NULL);
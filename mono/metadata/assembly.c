@@ -34,11 +34,15 @@
 #include <mono/metadata/reflection.h>
 #include <mono/metadata/coree.h>
 #include <mono/utils/mono-io-portability.h>
+#include <mono/utils/mono-mmap.h>
+#include <mono/utils/mono-proclib.h>
+#include <mono/utils/mono-threads.h>
 
 #ifndef HOST_WIN32
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #endif
 
 #ifdef PLATFORM_MACOSX
@@ -2657,18 +2661,17 @@ mono_assembly_apply_binding (MonoAssemblyName *aname, MonoAssemblyName *dest_nam
 	return dest_name;
 }
 
-/**
- * mono_assembly_load_from_gac
+/*
+ * get_gac_subpath:
  *
- * @aname: The assembly name object
+ *   Return the path of FILENAME relative to the root of a GAC, or NULL if ANAME
+ * is not strongly named.
  */
-static MonoAssembly*
-mono_assembly_load_from_gac (MonoAssemblyName *aname,  gchar *filename, MonoImageOpenStatus *status, MonoBoolean refonly)
+static gchar*
+get_gac_subpath (MonoAssemblyName *aname, const gchar *filename)
 {
-	MonoAssembly *result = NULL;
-	gchar *name, *version, *culture, *fullpath, *subpath;
+	gchar *name, *version, *culture, *subpath;
 	gint32 len;
-	gchar **paths;
 	char *pubtok;
 
 	if (aname->public_key_token [0] == 0) {
@@ -2700,6 +2703,25 @@ mono_assembly_load_from_gac (MonoAssemblyName *aname,  gchar *filename, MonoImag
 	g_free (version);
 	g_free (culture);
 
+	return subpath;
+}
+
+/**
+ * mono_assembly_load_from_gac
+ *
+ * @aname: The assembly name object
+ */
+static MonoAssembly*
+mono_assembly_load_from_gac (MonoAssemblyName *aname,  gchar *filename, MonoImageOpenStatus *status, MonoBoolean refonly)
+{
+	MonoAssembly *result = NULL;
+	gchar *fullpath, *subpath;
+	gchar **paths;
+
+	subpath = get_gac_subpath (aname, filename);
+	if (!subpath)
+		return NULL;
+
 	if (extra_gac_paths) {
 		paths = extra_gac_paths;
 		while (!result && *paths) {
@@ -3046,6 +3068,246 @@ mono_assembly_foreach (GFunc func, gpointer user_data)
 	g_list_free (copy);
 }
 
+/*
+ * Prefetching of referenced images.
+ *
+ * Most of the cost of loading an assembly is in opening its image: mapping the
+ * file, verifying the PE/CLI headers and loading the metadata tables. This is
+ * done outside the images lock, so when MONO_PARALLEL_LOAD is set, the images
+ * referenced by the main assembly are opened ahead of time by a few worker
+ * threads, walking the reference graph breadth first. The workers only fill
+ * the image cache, the assemblies themselves are still created on demand by
+ * mono_assembly_load_reference () on the loading thread, under the usual locks.
+ * A prefetch which guesses the wrong file only wastes some work.
+ */
+typedef struct {
+	MonoImage *image;
+	int index;
+} PrefetchItem;
+
+/* This protects all the prefetch_ variables below */
+#define mono_prefetch_lock() EnterCriticalSection (&prefetch_mutex)
+#define mono_prefetch_unlock() LeaveCriticalSection (&prefetch_mutex)
+static CRITICAL_SECTION prefetch_mutex;
+static gboolean prefetch_inited;
+static gboolean prefetch_shutdown;
+static GQueue *prefetch_queue;
+/* Assembly names already queued */
+static GHashTable *prefetch_names;
+/* Images we hold a reference to */
+static GSList *prefetch_images;
+static int prefetch_workers, prefetch_max_workers;
+
+static gpointer prefetch_worker (gpointer arg);
+
+/* LOCKING: Assumes the prefetch lock is held */
+static void
+prefetch_enqueue_references (MonoImage *image)
+{
+	MonoTableInfo *t = &image->tables [MONO_TABLE_ASSEMBLYREF];
+	MonoNativeThreadId tid;
+	PrefetchItem *item;
+	const char *name;
+	int i;
+
+	for (i = 0; i < t->rows; ++i) {
+		name = mono_metadata_string_heap (image, mono_metadata_decode_row_col (t, i, MONO_ASSEMBLYREF_NAME));
+		if (g_hash_table_lookup (prefetch_names, name))
+			continue;
+		g_hash_table_insert (prefetch_names, g_strdup (name), GINT_TO_POINTER (1));
+
+		item = g_new0 (PrefetchItem, 1);
+		item->image = image;
+		item->index = i;
+		g_queue_push_tail (prefetch_queue, item);
+
+		if (prefetch_workers < prefetch_max_workers) {
+			prefetch_workers ++;
+			if (!mono_native_thread_create (&tid, prefetch_worker, NULL))
+				prefetch_workers --;
+		}
+	}
+}
+
+static MonoImage*
+prefetch_open (const char *path)
+{
+	MonoImageOpenStatus status;
+
+	if (!g_file_test (path, G_FILE_TEST_IS_REGULAR))
+		return NULL;
+	return mono_image_open_full (path, &status, FALSE);
+}
+
+/*
+ * prefetch_reference:
+ *
+ *   Open the image the INDEXth assembly reference of IMAGE would most likely
+ * resolve to, following the same search order as mono_assembly_load_full ().
+ */
+static MonoImage*
+prefetch_reference (MonoImage *image, int index)
+{
+	MonoAssemblyName aname, maped_aname;
+	MonoAssemblyName *ref_aname;
+	MonoImage *res = NULL;
+	gchar *filename, *subpath, *fullpath, *basedir;
+	gchar **paths;
+	int i;
+
+	memset (&aname, 0, sizeof (MonoAssemblyName));
+	mono_assembly_get_assemblyref (image, index, &aname);
+	ref_aname = mono_assembly_remap_version (&aname, &maped_aname);
+
+	filename = g_strconcat (ref_aname->name, ".dll", NULL);
+
+	subpath = get_gac_subpath (ref_aname, filename);
+	if (subpath) {
+		for (paths = extra_gac_paths; !res && paths && *paths; paths++) {
+			fullpath = g_build_path (G_DIR_SEPARATOR_S, *paths, "lib", "mono", "gac", subpath, NULL);
+			res = prefetch_open (fullpath);
+			g_free (fullpath);
+		}
+		if (!res && mono_assembly_getrootdir ()) {
+			fullpath = g_build_path (G_DIR_SEPARATOR_S, mono_assembly_getrootdir (), "mono", "gac", subpath, NULL);
+			res = prefetch_open (fullpath);
+			g_free (fullpath);
+		}
+		g_free (subpath);
+	}
+
+	if (!res) {
+		basedir = g_path_get_dirname (image->name);
+		fullpath = g_build_filename (basedir, filename, NULL);
+		res = prefetch_open (fullpath);
+		g_free (fullpath);
+		g_free (basedir);
+	}
+
+	for (i = 0; !res && default_path [i]; ++i) {
+		fullpath = g_build_filename (default_path [i], filename, NULL);
+		res = prefetch_open (fullpath);
+		g_free (fullpath);
+	}
+
+	g_free (filename);
+
+	return res;
+}
+
+static gpointer
+prefetch_worker (gpointer arg)
+{
+	PrefetchItem *item;
+	MonoImage *image;
+
+	while (TRUE) {
+		mono_prefetch_lock ();
+		item = prefetch_shutdown ? NULL : g_queue_pop_head (prefetch_queue);
+		if (!item) {
+			prefetch_workers --;
+			mono_prefetch_unlock ();
+			break;
+		}
+		mono_prefetch_unlock ();
+
+		/* item->image is kept alive by the reference in prefetch_images */
+		image = prefetch_reference (item->image, item->index);
+		g_free (item);
+		if (!image)
+			continue;
+
+		mono_prefetch_lock ();
+		prefetch_images = g_slist_prepend (prefetch_images, image);
+		if (!prefetch_shutdown)
+			prefetch_enqueue_references (image);
+		mono_prefetch_unlock ();
+	}
+
+	return NULL;
+}
+
+/*
+ * mono_assembly_prefetch_references:
+ *
+ *   Start opening the images referenced by ASSEMBLY, and transitively the images
+ * referenced by those, on worker threads if MONO_PARALLEL_LOAD is set in the
+ * environment. Its value is the number of workers to use, 0 means one per cpu.
+ */
+void
+mono_assembly_prefetch_references (MonoAssembly *assembly)
+{
+	const char *val = g_getenv ("MONO_PARALLEL_LOAD");
+
+	if (!val || prefetch_inited || assembly->image->dynamic)
+		return;
+	/* Module load events would be emitted from the workers */
+	if (mono_profiler_get_events () != MONO_PROFILE_NONE)
+		return;
+
+	prefetch_max_workers = atoi (val);
+	if (prefetch_max_workers <= 0)
+		prefetch_max_workers = mono_cpu_count ();
+
+	InitializeCriticalSection (&prefetch_mutex);
+	prefetch_queue = g_queue_new ();
+	prefetch_names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	prefetch_inited = TRUE;
+
+	mono_prefetch_lock ();
+	mono_image_addref (assembly->image);
+	prefetch_images = g_slist_prepend (prefetch_images, assembly->image);
+	g_hash_table_insert (prefetch_names, g_strdup (assembly->aname.name), GINT_TO_POINTER (1));
+	prefetch_enqueue_references (assembly->image);
+	mono_prefetch_unlock ();
+}
+
+static void
+prefetch_cleanup (void)
+{
+	GSList *l;
+	PrefetchItem *item;
+
+	if (!prefetch_inited)
+		return;
+
+	mono_prefetch_lock ();
+	prefetch_shutdown = TRUE;
+	mono_prefetch_unlock ();
+
+	/* The workers exit after opening their current image */
+	while (TRUE) {
+		mono_prefetch_lock ();
+		if (prefetch_workers == 0)
+			break;
+		mono_prefetch_unlock ();
+		g_usleep (1000);
+	}
+	mono_prefetch_unlock ();
+
+	/*
+	 * Images which were loaded as assemblies are owned by their domains by now,
+	 * and might reference assemblies which are already freed, so only release
+	 * the ones nobody asked for.
+	 */
+	for (l = prefetch_images; l; l = l->next) {
+		MonoImage *image = l->data;
+
+		if (!image->assembly)
+			mono_image_close (image);
+	}
+	g_slist_free (prefetch_images);
+	prefetch_images = NULL;
+
+	while ((item = g_queue_pop_head (prefetch_queue)))
+		g_free (item);
+	g_queue_free (prefetch_queue);
+	g_hash_table_destroy (prefetch_names);
+
+	DeleteCriticalSection (&prefetch_mutex);
+	prefetch_inited = FALSE;
+}
+
 /**
  * mono_assemblies_cleanup:
  *
@@ -3056,6 +3318,8 @@ mono_assemblies_cleanup (void)
 {
 	GSList *l;
 
+	prefetch_cleanup ();
+
 	DeleteCriticalSection (&assemblies_mutex);
 
 	for (l = loaded_assembly_bindings; l; l = l->next) {
@@ -3133,6 +3397,129 @@ mono_register_bundled_assemblies (const MonoBundledAssembly **assemblies)
 	bundles = assemblies;
 }
 
+/*
+ * Assemblies appended to the executable by mkbundle --mmap.
+ *
+ * The file ends with a trailer of BUNDLE_TRAILER_SIZE bytes:
+ *   guint64 index_offset, guint32 index_size, guint32 count, char magic [8]
+ * The index has COUNT entries of:
+ *   guint64 offset, guint64 size, guint32 name_len, name_len bytes of name
+ * all in little endian. The data of each assembly starts at a 64k aligned offset,
+ * a multiple of the page size on every supported system, so it can be mapped
+ * directly from the file: nothing is copied and
+ * the pages are shared between all the processes running the executable.
+ * The first entry is the main assembly.
+ */
+#define BUNDLE_MAGIC "MBUNDLE1"
+#define BUNDLE_TRAILER_SIZE 24
+#define BUNDLE_MAX_INDEX_SIZE (16 * 1024 * 1024)
+
+static MonoBundledAssembly **mapped_bundles;
+
+/*
+ * mono_register_bundled_assemblies_from_file:
+ *
+ *   Check whether PATH has assemblies appended to it by mkbundle --mmap, and if so,
+ * map them into memory and register them with mono_register_bundled_assemblies ().
+ * Returns the name of the main assembly, or NULL if PATH has no bundle.
+ */
+const char*
+mono_register_bundled_assemblies_from_file (const char *path)
+{
+#ifdef HOST_WIN32
+	return NULL;
+#else
+	guint8 trailer [BUNDLE_TRAILER_SIZE];
+	guint8 *index = NULL, *p, *end;
+	guint64 index_offset, offset, size, file_size;
+	guint32 index_size, count, name_len, i;
+	MonoBundledAssembly **entries;
+	void **handles = NULL;
+	const char *res = NULL;
+	struct stat st;
+	int fd;
+
+	if (mapped_bundles)
+		return mapped_bundles [0]->name;
+
+	fd = open (path, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+	if (fstat (fd, &st) == -1 || st.st_size < BUNDLE_TRAILER_SIZE)
+		goto done;
+	file_size = st.st_size;
+
+	if (lseek (fd, file_size - BUNDLE_TRAILER_SIZE, SEEK_SET) == -1 || read (fd, trailer, BUNDLE_TRAILER_SIZE) != BUNDLE_TRAILER_SIZE)
+		goto done;
+	if (memcmp (trailer + 16, BUNDLE_MAGIC, 8) != 0)
+		goto done;
+
+	index_offset = read64 (trailer);
+	index_size = read32 (trailer + 8);
+	count = read32 (trailer + 12);
+	if (count == 0 || count > index_size / 21 || index_size > BUNDLE_MAX_INDEX_SIZE || index_offset > file_size || index_offset + index_size > file_size - BUNDLE_TRAILER_SIZE)
+		goto done;
+
+	index = g_malloc (index_size);
+	if (lseek (fd, index_offset, SEEK_SET) == -1 || read (fd, index, index_size) != (ssize_t)index_size)
+		goto done;
+
+	entries = g_new0 (MonoBundledAssembly*, count + 1);
+	handles = g_new0 (void*, count);
+	p = index;
+	end = index + index_size;
+	for (i = 0; i < count; ++i) {
+		char *name;
+		void *data;
+
+		if (end - p < 20)
+			break;
+		offset = read64 (p);
+		size = read64 (p + 8);
+		name_len = read32 (p + 16);
+		p += 20;
+		if (name_len == 0 || (guint32)(end - p) < name_len)
+			break;
+		if (size == 0 || size > G_MAXUINT32 || offset % mono_pagesize () != 0 || offset > index_offset || size > index_offset - offset)
+			break;
+
+		data = mono_file_map (size, MONO_MMAP_READ | MONO_MMAP_PRIVATE, fd, offset, &handles [i]);
+		if (!data)
+			break;
+		name = g_strndup ((char*)p, name_len);
+		p += name_len;
+
+		{
+			MonoBundledAssembly entry = { name, data, size };
+
+			entries [i] = g_memdup (&entry, sizeof (MonoBundledAssembly));
+		}
+	}
+
+	if (i < count) {
+		g_warning ("The assembly bundle appended to '%s' is corrupt.", path);
+		for (i = 0; entries [i]; ++i) {
+			mono_file_unmap ((void*)entries [i]->data, handles [i]);
+			g_free ((char*)entries [i]->name);
+			g_free (entries [i]);
+		}
+		g_free (entries);
+		goto done;
+	}
+
+	/* The mappings are kept for the lifetime of the process */
+	mapped_bundles = entries;
+	mono_register_bundled_assemblies ((const MonoBundledAssembly**)mapped_bundles);
+	res = mapped_bundles [0]->name;
+
+done:
+	g_free (handles);
+	g_free (index);
+	close (fd);
+	return res;
+#endif
+}
+
 #define MONO_DECLSEC_FORMAT_10		0x3C
 #define MONO_DECLSEC_FORMAT_20		0x2E
 #define MONO_DECLSEC_FIELD		0x53
@@ -38,6 +38,7 @@
 #include <mono/metadata/attrdefs.h>
 #include <mono/metadata/gc-internal.h>
 #include <mono/metadata/verify-internals.h>
+#include <mono/metadata/layout-cache.h>
 #include <mono/metadata/mono-debug.h>
 #include <mono/utils/mono-counters.h>
 #include <mono/utils/mono-string.h>
@@ -1695,6 +1696,9 @@ mono_class_layout_fields (MonoClass *class)
 	gboolean gc_aware_layout = FALSE;
 	MonoClassField *field;
 
+	if (mono_layout_cache_get_field_layout (class))
+		return;
+
 	/*
 	 * When we do generic sharing we need to have layout
 	 * information for open generic classes (either with a generic
@@ -3213,6 +3217,44 @@ mono_class_interface_match (const uint8_t *bitmap, int id)
 }
 #endif
 
+/*
+ * set_interfaces_packed:
+ *
+ *   Initialize the interfaces_packed, interface_offsets_packed and interface_bitmap
+ * fields of CLASS from the first COUNT entries of INTERFACES and OFFSETS.
+ * LOCKING: this is supposed to be called with the loader lock held.
+ */
+static void
+set_interfaces_packed (MonoClass *class, MonoClass **interfaces, int *offsets, int count, int max_iid)
+{
+	uint8_t *bitmap;
+	int i, bsize;
+
+	class->interface_offsets_count = count;
+	class->interfaces_packed = mono_class_alloc (class, sizeof (MonoClass*) * count);
+	class->interface_offsets_packed = mono_class_alloc (class, sizeof (guint16) * count);
+	bsize = (sizeof (guint8) * ((max_iid + 1) >> 3)) + (((max_iid + 1) & 7)? 1 :0);
+#ifdef COMPRESSED_INTERFACE_BITMAP
+	bitmap = g_malloc0 (bsize);
+#else
+	bitmap = mono_class_alloc0 (class, bsize);
+#endif
+	for (i = 0; i < count; i++) {
+		int id = interfaces [i]->interface_id;
+		bitmap [id >> 3] |= (1 << (id & 7));
+		class->interfaces_packed [i] = interfaces [i];
+		class->interface_offsets_packed [i] = offsets [i];
+	}
+#ifdef COMPRESSED_INTERFACE_BITMAP
+	i = mono_compress_bitmap (NULL, bitmap, bsize);
+	class->interface_bitmap = mono_class_alloc0 (class, i);
+	mono_compress_bitmap (class->interface_bitmap, bitmap, bsize);
+	g_free (bitmap);
+#else
+	class->interface_bitmap = bitmap;
+#endif
+}
+
 /*
  * LOCKING: this is supposed to be called with the loader lock held.
  * Return -1 on failure and set exception_type
@@ -3231,6 +3273,8 @@ setup_interface_offsets (MonoClass *class, int cur_slot, gboolean overwrite)
 	MonoClass **array_interfaces = NULL;
 	int num_array_interfaces;
 	int is_enumerator = FALSE;
+	MonoClass *parent = class->parent;
+	gboolean from_parent;
 
 	mono_class_setup_supertypes (class);
 	/* 
@@ -3240,11 +3284,21 @@ setup_interface_offsets (MonoClass *class, int cur_slot, gboolean overwrite)
 	 */
 	array_interfaces = get_implicit_generic_array_interfaces (class, &num_array_interfaces, &is_enumerator);
 
+	/*
+	 * The parent already merged the interfaces of all of its supertypes, with
+	 * the offsets we have to share, into interfaces_packed. Start from that
+	 * instead of collecting the implemented interfaces of every ancestor again,
+	 * which made this quadratic in the depth of the hierarchy.
+	 */
+	from_parent = parent && parent->interfaces_packed && class->idepth > 1 && class->supertypes [class->idepth - 2] == parent;
+
 	/* compute maximum number of slots and maximum interface id */
-	max_iid = 0;
+	max_iid = from_parent ? parent->max_interface_id : 0;
 	num_ifaces = num_array_interfaces; /* this can include duplicated ones */
+	if (from_parent)
+		num_ifaces += parent->interface_offsets_count;
 	ifaces_array = g_new0 (GPtrArray *, class->idepth);
-	for (j = 0; j < class->idepth; j++) {
+	for (j = from_parent ? class->idepth - 1 : 0; j < class->idepth; j++) {
 		k = class->supertypes [j];
 		num_ifaces += k->interface_count;
 		for (i = 0; i < k->interface_count; i++) {
@@ -3297,8 +3351,13 @@ setup_interface_offsets (MonoClass *class, int cur_slot, gboolean overwrite)
 		interface_offsets_full [i] = -1;
 	}
 
+	if (from_parent) {
+		for (i = 0; i < parent->interface_offsets_count; ++i)
+			set_interface_and_offset (num_ifaces, interfaces_full, interface_offsets_full, parent->interfaces_packed [i], parent->interface_offsets_packed [i], TRUE);
+	}
+
 	/* skip the current class */
-	for (j = 0; j < class->idepth - 1; j++) {
+	for (j = from_parent ? class->idepth - 1 : 0; j < class->idepth - 1; j++) {
 		k = class->supertypes [j];
 		ifaces = ifaces_array [j];
 
@@ -3404,33 +3463,7 @@ setup_interface_offsets (MonoClass *class, int cur_slot, gboolean overwrite)
 	if (class->interfaces_packed && !overwrite) {
 		g_assert (class->interface_offsets_count == interface_offsets_count);
 	} else {
-		uint8_t *bitmap;
-		int bsize;
-		class->interface_offsets_count = interface_offsets_count;
-		class->interfaces_packed = mono_class_alloc (class, sizeof (MonoClass*) * interface_offsets_count);
-		class->interface_offsets_packed = mono_class_alloc (class, sizeof (guint16) * interface_offsets_count);
-		bsize = (sizeof (guint8) * ((max_iid + 1) >> 3)) + (((max_iid + 1) & 7)? 1 :0);
-#ifdef COMPRESSED_INTERFACE_BITMAP
-		bitmap = g_malloc0 (bsize);
-#else
-		bitmap = mono_class_alloc0 (class, bsize);
-#endif
-		for (i = 0; i < interface_offsets_count; i++) {
-			int id = interfaces_full [i]->interface_id;
-			bitmap [id >> 3] |= (1 << (id & 7));
-			class->interfaces_packed [i] = interfaces_full [i];
-			class->interface_offsets_packed [i] = interface_offsets_full [i];
-			/*if (num_array_interfaces)
-			  g_print ("type %s has %s offset at %d\n", mono_type_get_name_full (&class->byval_arg, 0), mono_type_get_name_full (&interfaces_full [i]->byval_arg, 0), interface_offsets_full [i]);*/
-		}
-#ifdef COMPRESSED_INTERFACE_BITMAP
-		i = mono_compress_bitmap (NULL, bitmap, bsize);
-		class->interface_bitmap = mono_class_alloc0 (class, i);
-		mono_compress_bitmap (class->interface_bitmap, bitmap, bsize);
-		g_free (bitmap);
-#else
-		class->interface_bitmap = bitmap;
-#endif
+		set_interfaces_packed (class, interfaces_full, interface_offsets_full, interface_offsets_count, max_iid);
 	}
 
 end:
@@ -3450,6 +3483,48 @@ end:
  	return cur_slot;
 }
 
+/*
+ * setup_interface_offsets_from_cache:
+ *
+ *   Set up the interface offsets of CLASS from the layout cache, the same way
+ * setup_interface_offsets () would. Return FALSE if CLASS is not cached.
+ * LOCKING: this is supposed to be called with the loader lock held.
+ */
+static gboolean
+setup_interface_offsets_from_cache (MonoClass *class)
+{
+	MonoClass **interfaces, *ic;
+	int *offsets;
+	int i, j, offset, count, max_iid = 0;
+
+	if (!mono_layout_cache_get_interface_offsets (class, &interfaces, &offsets, &count))
+		return FALSE;
+
+	mono_class_setup_supertypes (class);
+
+	/* Interface ids are assigned at runtime, so the order of the cached interfaces can differ */
+	for (i = 1; i < count; ++i) {
+		ic = interfaces [i];
+		offset = offsets [i];
+		for (j = i; j > 0 && interfaces [j - 1]->interface_id > ic->interface_id; --j) {
+			interfaces [j] = interfaces [j - 1];
+			offsets [j] = offsets [j - 1];
+		}
+		interfaces [j] = ic;
+		offsets [j] = offset;
+	}
+	for (i = 0; i < count; ++i) {
+		if (max_iid < interfaces [i]->interface_id)
+			max_iid = interfaces [i]->interface_id;
+	}
+	class->max_interface_id = max_iid;
+	set_interfaces_packed (class, interfaces, offsets, count, max_iid);
+
+	g_free (interfaces);
+	g_free (offsets);
+	return TRUE;
+}
+
 /*
  * Setup interface offsets for interfaces. 
  * Initializes:
@@ -3541,6 +3616,52 @@ mono_class_setup_vtable (MonoClass *class)
 	mono_class_setup_vtable_full (class, NULL);
 }
 
+/*
+ * setup_vtable_from_cache:
+ *
+ *   Set up the vtable of CLASS from the layout cache, the same way
+ * mono_class_setup_vtable_general () would. Return FALSE if CLASS is not cached.
+ * LOCKING: this is supposed to be called with the loader lock held.
+ */
+static gboolean
+setup_vtable_from_cache (MonoClass *class, GList *in_setup)
+{
+	MonoMethod **vtable, **tmp;
+	int vtable_size;
+
+	if (!class->inited || !class->interfaces_packed)
+		return FALSE;
+
+	if (class->parent) {
+		mono_class_setup_vtable_full (class->parent, in_setup);
+		if (class->parent->exception_type || !class->parent->vtable)
+			return FALSE;
+	}
+
+	vtable = mono_layout_cache_get_vtable (class, &vtable_size);
+	if (!vtable)
+		return FALSE;
+	if (class->vtable_size && class->vtable_size != vtable_size) {
+		g_free (vtable);
+		return FALSE;
+	}
+	class->vtable_size = vtable_size;
+
+	/* Try to share the vtable with our parent. */
+	if (class->parent && (class->parent->vtable_size == class->vtable_size) && (memcmp (class->parent->vtable, vtable, sizeof (gpointer) * class->vtable_size) == 0)) {
+		mono_memory_barrier ();
+		class->vtable = class->parent->vtable;
+	} else {
+		tmp = mono_class_alloc0 (class, sizeof (gpointer) * class->vtable_size);
+		memcpy (tmp, vtable, sizeof (gpointer) * class->vtable_size);
+		mono_memory_barrier ();
+		class->vtable = tmp;
+	}
+
+	g_free (vtable);
+	return TRUE;
+}
+
 static void
 mono_class_setup_vtable_full (MonoClass *class, GList *in_setup)
 {
@@ -3579,6 +3700,12 @@ mono_class_setup_vtable_full (MonoClass *class, GList *in_setup)
 	mono_stats.generic_vtable_count ++;
 	in_setup = g_list_prepend (in_setup, class);
 
+	if (setup_vtable_from_cache (class, in_setup)) {
+		mono_loader_unlock ();
+		g_list_remove (in_setup, class);
+		return;
+	}
+
 	if (class->generic_class) {
 		if (!mono_class_check_vtable_constraints (class, in_setup)) {
 			mono_loader_unlock ();
@@ -5074,8 +5201,9 @@ mono_class_init (MonoClass *class)
 		first_iface_slot = class->parent->vtable_size;
 		if (mono_class_need_stelemref_method (class))
 			++first_iface_slot;
-		setup_interface_offsets (class, first_iface_slot, TRUE);
-	} else {
+		if (!setup_interface_offsets_from_cache (class))
+			setup_interface_offsets (class, first_iface_slot, TRUE);
+	} else if (!setup_interface_offsets_from_cache (class)) {
 		setup_interface_offsets (class, 0, TRUE);
 	}
 
@@ -7180,6 +7308,128 @@ mono_image_init_name_cache (MonoImage *image)
 	mono_image_unlock (image);
 }
 
+typedef struct {
+	guint32 hash;
+	/* Same values as in name_cache: a TYPEDEF row or an EXPORTEDTYPE token, 0 if free */
+	guint32 token;
+	/* String heap indexes */
+	guint32 name;
+	guint32 nspace;
+} MonoClassNameIndexEntry;
+
+typedef struct _MonoClassNameIndex {
+	/* Power of two */
+	guint32 size;
+	MonoClassNameIndexEntry entries [MONO_ZERO_LEN_ARRAY];
+} MonoClassNameIndex;
+
+static inline guint32
+class_name_index_hash (const char *nspace, const char *name)
+{
+	return (mono_metadata_str_hash (nspace) * 33) ^ mono_metadata_str_hash (name);
+}
+
+static void
+class_name_index_add (MonoImage *image, MonoClassNameIndex *index, guint32 nspace_idx, guint32 name_idx, guint32 token)
+{
+	const char *name = mono_metadata_string_heap (image, name_idx);
+	const char *nspace = mono_metadata_string_heap (image, nspace_idx);
+	guint32 hash = class_name_index_hash (nspace, name);
+	guint32 mask = index->size - 1;
+	guint32 i;
+
+	for (i = hash & mask; index->entries [i].token; i = (i + 1) & mask) {
+		MonoClassNameIndexEntry *entry = &index->entries [i];
+
+		/* Later entries replace earlier ones, like in mono_image_init_name_cache () */
+		if (entry->hash == hash && !strcmp (mono_metadata_string_heap (image, entry->name), name) &&
+			!strcmp (mono_metadata_string_heap (image, entry->nspace), nspace))
+			break;
+	}
+
+	index->entries [i].hash = hash;
+	index->entries [i].token = token;
+	index->entries [i].name = name_idx;
+	index->entries [i].nspace = nspace_idx;
+}
+
+/*
+ * class_name_index_create:
+ *
+ *   Build an open addressing hash table from (namespace, name) to the same tokens
+ * mono_image_init_name_cache () stores, without any per-namespace allocations.
+ */
+static MonoClassNameIndex*
+class_name_index_create (MonoImage *image)
+{
+	MonoTableInfo *t = &image->tables [MONO_TABLE_TYPEDEF];
+	MonoTableInfo *et = &image->tables [MONO_TABLE_EXPORTEDTYPE];
+	MonoClassNameIndex *index;
+	guint32 cols [MONO_TYPEDEF_SIZE];
+	guint32 ecols [MONO_EXP_TYPE_SIZE];
+	guint32 i, visib, size, count;
+
+	/* Keep the load factor below 3/4 */
+	count = t->rows + et->rows;
+	for (size = 16; size < count + count / 3 + 1; size <<= 1)
+		;
+
+	index = g_malloc0 (sizeof (MonoClassNameIndex) + size * sizeof (MonoClassNameIndexEntry));
+	index->size = size;
+
+	for (i = 1; i <= t->rows; ++i) {
+		mono_metadata_decode_row (t, i - 1, cols, MONO_TYPEDEF_SIZE);
+		/* Nested types are not accessible by name, see mono_image_init_name_cache () */
+		visib = cols [MONO_TYPEDEF_FLAGS] & TYPE_ATTRIBUTE_VISIBILITY_MASK;
+		if (visib >= TYPE_ATTRIBUTE_NESTED_PUBLIC && visib <= TYPE_ATTRIBUTE_NESTED_FAM_OR_ASSEM)
+			continue;
+		class_name_index_add (image, index, cols [MONO_TYPEDEF_NAMESPACE], cols [MONO_TYPEDEF_NAME], i);
+	}
+
+	for (i = 0; i < et->rows; ++i) {
+		mono_metadata_decode_row (et, i, ecols, MONO_EXP_TYPE_SIZE);
+		class_name_index_add (image, index, ecols [MONO_EXP_TYPE_NAMESPACE], ecols [MONO_EXP_TYPE_NAME],
+							  mono_metadata_make_token (MONO_TABLE_EXPORTEDTYPE, i + 1));
+	}
+
+	return index;
+}
+
+/*
+ * class_name_index_lookup:
+ *
+ *   Return the name_cache style token for NAME_SPACE.NAME in the non dynamic IMAGE,
+ * or 0 if there is no such type.
+ *
+ * LOCKING: None. The index is immutable once published in IMAGE, and threads racing
+ * to create it just throw away their copy.
+ */
+static guint32
+class_name_index_lookup (MonoImage *image, const char *name_space, const char *name)
+{
+	MonoClassNameIndex *index = image->class_name_index;
+	guint32 hash, mask, i;
+
+	if (!index) {
+		index = class_name_index_create (image);
+		if (InterlockedCompareExchangePointer ((gpointer*)&image->class_name_index, index, NULL) != NULL) {
+			g_free (index);
+			index = image->class_name_index;
+		}
+	}
+
+	hash = class_name_index_hash (name_space, name);
+	mask = index->size - 1;
+	for (i = hash & mask; index->entries [i].token; i = (i + 1) & mask) {
+		MonoClassNameIndexEntry *entry = &index->entries [i];
+
+		if (entry->hash == hash && !strcmp (mono_metadata_string_heap (image, entry->name), name) &&
+			!strcmp (mono_metadata_string_heap (image, entry->nspace), name_space))
+			return entry->token;
+	}
+	return 0;
+}
+
 /*FIXME Only dynamic assemblies should allow this operation.*/
 void
 mono_image_add_to_name_cache (MonoImage *image, const char *nspace, 
@@ -7391,17 +7641,22 @@ mono_class_from_name (MonoImage *image, const char* name_space, const char *name
 		}
 	}
 
-	mono_image_lock (image);
+	if (image->dynamic) {
+		/* Types are added to dynamic images as they are created */
+		mono_image_lock (image);
 
-	if (!image->name_cache)
-		mono_image_init_name_cache (image);
+		if (!image->name_cache)
+			mono_image_init_name_cache (image);
 
-	nspace_table = g_hash_table_lookup (image->name_cache, name_space);
+		nspace_table = g_hash_table_lookup (image->name_cache, name_space);
 
-	if (nspace_table)
-		token = GPOINTER_TO_UINT (g_hash_table_lookup (nspace_table, name));
+		if (nspace_table)
+			token = GPOINTER_TO_UINT (g_hash_table_lookup (nspace_table, name));
 
-	mono_image_unlock (image);
+		mono_image_unlock (image);
+	} else {
+		token = class_name_index_lookup (image, name_space, name);
+	}
 
 	if (!token && image->dynamic && image->modules) {
 		/* Search modules as well */
@@ -8204,10 +8459,9 @@ mono_install_get_cached_class_info (MonoGetCachedClassInfo func)
 static gboolean
 mono_class_get_cached_class_info (MonoClass *klass, MonoCachedClassInfo *res)
 {
-	if (!get_cached_class_info)
-		return FALSE;
-	else
-		return get_cached_class_info (klass, res);
+	if (get_cached_class_info && get_cached_class_info (klass, res))
+		return TRUE;
+	return mono_layout_cache_get_class_info (klass, res);
 }
 
 void
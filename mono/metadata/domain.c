@@ -70,6 +70,30 @@ MONO_FAST_TLS_DECLARE(tls_appdomain);
 
 #endif
 
+/*
+ * Per-thread cache of recent mono_jit_info_table_find () results, see
+ * jit_info_cache_lookup ().
+ */
+static MonoNativeTlsKey jit_info_cache_id;
+
+#ifdef MONO_HAVE_FAST_TLS
+
+MONO_FAST_TLS_DECLARE(tls_jit_info_cache);
+
+#define GET_JIT_INFO_CACHE() ((JitInfoCache*)MONO_FAST_TLS_GET(tls_jit_info_cache))
+
+#define SET_JIT_INFO_CACHE(x) do { \
+	MONO_FAST_TLS_SET (tls_jit_info_cache,x); \
+	mono_native_tls_set_value (jit_info_cache_id, x); \
+} while (FALSE)
+
+#else /* !MONO_HAVE_FAST_TLS */
+
+#define GET_JIT_INFO_CACHE() ((JitInfoCache*)mono_native_tls_get_value (jit_info_cache_id))
+#define SET_JIT_INFO_CACHE(x) mono_native_tls_set_value (jit_info_cache_id, x)
+
+#endif
+
 #define GET_APPCONTEXT() (mono_thread_internal_current ()->current_appcontext)
 #define SET_APPCONTEXT(x) MONO_OBJECT_SETREF (mono_thread_internal_current (), current_appcontext, (x))
 
@@ -109,6 +133,28 @@ typedef struct {
 	gpointer start, end;
 } AotModuleInfo;
 
+/*
+ * JitInfoCache: A small direct mapped cache from code addresses to the
+ * MonoJitInfo covering them, one per thread.  Each slot covers
+ * 1 << JIT_INFO_CACHE_SHIFT bytes of code.  The cache is only valid for
+ * DOMAIN and only as long as GENERATION matches jit_info_generation,
+ * which is bumped every time a MonoJitInfo might be freed.
+ */
+#define JIT_INFO_CACHE_SIZE 128
+#define JIT_INFO_CACHE_SHIFT 4
+
+#define JIT_INFO_CACHE_SLOT(addr) ((((gsize)(addr)) >> JIT_INFO_CACHE_SHIFT) & (JIT_INFO_CACHE_SIZE - 1))
+
+typedef struct {
+	MonoDomain *domain;
+	gint32 generation;
+	MonoJitInfo *entries [JIT_INFO_CACHE_SIZE];
+} JitInfoCache;
+
+static volatile gint32 jit_info_generation;
+
+static int jit_info_cache_hits, jit_info_cache_misses;
+
 static const MonoRuntimeInfo *current_runtime = NULL;
 
 static MonoJitInfoFindInAot jit_info_find_in_aot_func = NULL;
@@ -330,17 +376,102 @@ jit_info_table_chunk_index (MonoJitInfoTableChunk *chunk, MonoThreadHazardPointe
 	return left;
 }
 
+/*
+ * jit_info_cache_lookup:
+ *
+ *   Return the cached MonoJitInfo covering ADDR in DOMAIN, or NULL.  This
+ * can be called from signal handlers, so it doesn't allocate or take
+ * locks.  The entry is protected by hazard pointers the same way as in the
+ * table search, and the generation is checked again afterwards, so an
+ * entry which was removed concurrently is never returned.
+ */
+static MonoJitInfo*
+jit_info_cache_lookup (JitInfoCache *cache, MonoDomain *domain, MonoThreadHazardPointers *hp, char *addr)
+{
+	MonoJitInfo *ji;
+	gint32 generation = cache->generation;
+
+	if (cache->domain != domain || generation != jit_info_generation)
+		return NULL;
+
+	ji = cache->entries [JIT_INFO_CACHE_SLOT (addr)];
+	if (!ji)
+		return NULL;
+
+	get_hazardous_pointer ((gpointer volatile*)&domain->jit_info_table, hp, JIT_INFO_TABLE_HAZARD_INDEX);
+	mono_hazard_pointer_set (hp, JIT_INFO_HAZARD_INDEX, ji);
+	mono_memory_barrier ();
+
+	if (generation != jit_info_generation
+			|| (gint8*)addr < (gint8*)ji->code_start
+			|| (gint8*)addr >= (gint8*)ji->code_start + ji->code_size)
+		ji = NULL;
+
+	mono_hazard_pointer_clear (hp, JIT_INFO_TABLE_HAZARD_INDEX);
+	mono_hazard_pointer_clear (hp, JIT_INFO_HAZARD_INDEX);
+
+	return ji;
+}
+
+/*
+ * jit_info_cache_insert:
+ *
+ *   Remember that JI covers ADDR.  GENERATION is the value of
+ * jit_info_generation read before JI was looked up.  Every store is a
+ * single word, so a signal handler interrupting us on this thread sees
+ * either the old or the new entry.
+ */
+static void
+jit_info_cache_insert (JitInfoCache *cache, MonoDomain *domain, gint32 generation, char *addr, MonoJitInfo *ji)
+{
+	int slot = JIT_INFO_CACHE_SLOT (addr);
+
+	if (cache->domain != domain || cache->generation != generation) {
+		/* Make the cache invalid while it is being flushed */
+		cache->generation = generation - 1;
+		mono_memory_barrier ();
+		memset (cache->entries, 0, sizeof (cache->entries));
+		cache->domain = domain;
+		mono_memory_barrier ();
+		cache->generation = generation;
+	}
+
+	cache->entries [slot] = ji;
+	mono_memory_barrier ();
+	/* JI might have been removed after we found it */
+	if (generation != jit_info_generation)
+		cache->entries [slot] = NULL;
+}
+
+/*
+ * mono_jit_info_table_find_internal:
+ *
+ *   Same as mono_jit_info_table_find (), but if TRY_AOT is FALSE, AOT methods whose
+ * jit info hasn't been decoded yet are not found. That lookup takes locks and
+ * allocates, so passing FALSE makes this function async signal safe.
+ */
 MonoJitInfo*
-mono_jit_info_table_find (MonoDomain *domain, char *addr)
+mono_jit_info_table_find_internal (MonoDomain *domain, char *addr, gboolean try_aot)
 {
 	MonoJitInfoTable *table;
 	MonoJitInfo *ji;
 	int chunk_pos, pos;
 	MonoThreadHazardPointers *hp = mono_hazard_pointer_get ();
 	MonoImage *image;
+	JitInfoCache *cache = GET_JIT_INFO_CACHE ();
+	gint32 generation = jit_info_generation;
 
 	++mono_stats.jit_info_table_lookup_count;
 
+	if (cache && hp) {
+		ji = jit_info_cache_lookup (cache, domain, hp, addr);
+		if (ji) {
+			++jit_info_cache_hits;
+			return ji;
+		}
+		++jit_info_cache_misses;
+	}
+
 	/* First we have to get the domain's jit_info_table.  This is
 	   complicated by the fact that a writer might substitute a
 	   new table and free the old one.  What the writer guarantees
@@ -375,6 +506,8 @@ mono_jit_info_table_find (MonoDomain *domain, char *addr)
 			}
 			if ((gint8*)addr >= (gint8*)ji->code_start
 					&& (gint8*)addr < (gint8*)ji->code_start + ji->code_size) {
+				if (cache && hp)
+					jit_info_cache_insert (cache, domain, generation, addr, ji);
 				mono_hazard_pointer_clear (hp, JIT_INFO_TABLE_HAZARD_INDEX);
 				mono_hazard_pointer_clear (hp, JIT_INFO_HAZARD_INDEX);
 				return ji;
@@ -400,14 +533,27 @@ mono_jit_info_table_find (MonoDomain *domain, char *addr)
 
 	ji = NULL;
 
+	if (!try_aot)
+		return NULL;
+
 	/* Maybe its an AOT module */
 	image = mono_jit_info_find_aot_module ((guint8*)addr);
 	if (image)
 		ji = jit_info_find_in_aot_func (domain, image, addr);
+
+	/* AOT jit infos are added to the table, so they live as long as the domain */
+	if (ji && cache)
+		jit_info_cache_insert (cache, domain, generation, addr, ji);
 	
 	return ji;
 }
 
+MonoJitInfo*
+mono_jit_info_table_find (MonoDomain *domain, char *addr)
+{
+	return mono_jit_info_table_find_internal (domain, addr, TRUE);
+}
+
 static G_GNUC_UNUSED void
 jit_info_table_check (MonoJitInfoTable *table)
 {
@@ -804,6 +950,10 @@ mono_jit_info_table_remove (MonoDomain *domain, MonoJitInfo *ji)
  found:
 	g_assert (chunk->data [pos] == ji);
 
+	/* Invalidate the per-thread caches before JI can be freed */
+	InterlockedIncrement (&jit_info_generation);
+	mono_memory_barrier ();
+
 	chunk->data [pos] = mono_jit_info_make_tombstone (ji);
 
 	/* Debugging code, should be removed. */
@@ -1292,6 +1442,11 @@ mono_init_internal (const char *filename, const char *exe_filename, const char *
 
 	MONO_FAST_TLS_INIT (tls_appdomain);
 	mono_native_tls_alloc (&appdomain_thread_id, NULL);
+	MONO_FAST_TLS_INIT (tls_jit_info_cache);
+	mono_native_tls_alloc (&jit_info_cache_id, NULL);
+
+	mono_counters_register ("JIT info cache hits", MONO_COUNTER_INT|MONO_COUNTER_JIT, &jit_info_cache_hits);
+	mono_counters_register ("JIT info cache misses", MONO_COUNTER_INT|MONO_COUNTER_JIT, &jit_info_cache_misses);
 
 	InitializeCriticalSection (&appdomains_mutex);
 
@@ -1749,6 +1904,7 @@ mono_cleanup (void)
 	mono_metadata_cleanup ();
 
 	mono_native_tls_free (appdomain_thread_id);
+	mono_native_tls_free (jit_info_cache_id);
 	DeleteCriticalSection (&appdomains_mutex);
 
 #ifndef HOST_WIN32
@@ -1794,7 +1950,15 @@ mono_domain_get ()
 void
 mono_domain_unset (void)
 {
+	JitInfoCache *cache = GET_JIT_INFO_CACHE ();
+
 	SET_APPDOMAIN (NULL);
+
+	/* This is called when threads exit or detach */
+	if (cache) {
+		SET_JIT_INFO_CACHE (NULL);
+		g_free (cache);
+	}
 }
 
 void
@@ -1808,6 +1972,13 @@ mono_domain_set_internal_with_options (MonoDomain *domain, gboolean migrate_exce
 	SET_APPDOMAIN (domain);
 	SET_APPCONTEXT (domain->default_context);
 
+	/*
+	 * The jit info cache is allocated here since mono_jit_info_table_find ()
+	 * might run inside signal handlers.
+	 */
+	if (!GET_JIT_INFO_CACHE ())
+		SET_JIT_INFO_CACHE (g_new0 (JitInfoCache, 1));
+
 	if (migrate_exception) {
 		thread = mono_thread_internal_current ();
 		if (!thread->abort_exc)
@@ -2028,6 +2199,8 @@ mono_domain_free (MonoDomain *domain, gboolean force)
 	 * are not freed.  Since the domain cannot be in use anymore,
 	 * this will free them.
 	 */
+	InterlockedIncrement (&jit_info_generation);
+	mono_memory_barrier ();
 	mono_thread_hazardous_try_free_all ();
 	g_assert (domain->num_jit_info_tables == 1);
 	jit_info_table_free (domain->jit_info_table);
@@ -7869,6 +7869,12 @@ icall_symbols [] = {
 #endif /* DISABLE_ICALL_TABLES */
 
 static GHashTable *icall_hash = NULL;
+/* Whenever some name in icall_hash includes a signature */
+static gboolean icall_hash_has_signatures;
+/* This protects icall_hash, it is a leaf lock */
+#define mono_icall_lock() EnterCriticalSection (&icall_mutex)
+#define mono_icall_unlock() LeaveCriticalSection (&icall_mutex)
+static CRITICAL_SECTION icall_mutex;
 static GHashTable *jit_icall_hash_name = NULL;
 static GHashTable *jit_icall_hash_addr = NULL;
 
@@ -7905,6 +7911,7 @@ mono_icall_init (void)
 #endif
 
 	icall_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	InitializeCriticalSection (&icall_mutex);
 }
 
 void
@@ -7913,16 +7920,19 @@ mono_icall_cleanup (void)
 	g_hash_table_destroy (icall_hash);
 	g_hash_table_destroy (jit_icall_hash_name);
 	g_hash_table_destroy (jit_icall_hash_addr);
+	DeleteCriticalSection (&icall_mutex);
 }
 
 void
 mono_add_internal_call (const char *name, gconstpointer method)
 {
-	mono_loader_lock ();
+	mono_icall_lock ();
 
 	g_hash_table_insert (icall_hash, g_strdup (name), (gpointer) method);
+	if (strchr (name, '('))
+		icall_hash_has_signatures = TRUE;
 
-	mono_loader_unlock ();
+	mono_icall_unlock ();
 }
 
 #ifndef DISABLE_ICALL_TABLES
@@ -8027,13 +8037,37 @@ no_icall_table (void)
 }
 #endif
 
+/*
+ * Appends the "(sig)" part of the icall name of METHOD at SIGSTART, which
+ * points inside the MNAME buffer of MNAME_SIZE bytes.
+ */
+static gboolean
+append_icall_signature (MonoMethod *method, char *mname, int mname_size, char *sigstart)
+{
+	char *tmpsig;
+	int siglen;
+
+	tmpsig = mono_signature_get_desc (mono_method_signature (method), TRUE);
+	siglen = strlen (tmpsig);
+	if ((sigstart - mname) + siglen + 4 > mname_size) {
+		g_free (tmpsig);
+		return FALSE;
+	}
+	sigstart [0] = '(';
+	memcpy (sigstart + 1, tmpsig, siglen);
+	sigstart [siglen + 1] = ')';
+	sigstart [siglen + 2] = 0;
+	g_free (tmpsig);
+	return TRUE;
+}
+
 gpointer
 mono_lookup_internal_call (MonoMethod *method)
 {
 	char *sigstart;
-	char *tmpsig;
 	char mname [2048];
-	int typelen = 0, mlen, siglen;
+	int typelen = 0, mlen;
+	gboolean have_sig = FALSE;
 	gpointer res;
 #ifndef DISABLE_ICALL_TABLES
 	const IcallTypeDesc *imap = NULL;
@@ -8071,37 +8105,34 @@ mono_lookup_internal_call (MonoMethod *method)
 	mname [typelen + 1] = ':';
 
 	mlen = strlen (method->name);
+	if (typelen + mlen + 6 > sizeof (mname))
+		return NULL;
 	memcpy (mname + typelen + 2, method->name, mlen);
 	sigstart = mname + typelen + 2 + mlen;
 	*sigstart = 0;
 
-	tmpsig = mono_signature_get_desc (mono_method_signature (method), TRUE);
-	siglen = strlen (tmpsig);
-	if (typelen + mlen + siglen + 6 > sizeof (mname))
-		return NULL;
-	sigstart [0] = '(';
-	memcpy (sigstart + 1, tmpsig, siglen);
-	sigstart [siglen + 1] = ')';
-	sigstart [siglen + 2] = 0;
-	g_free (tmpsig);
-	
-	mono_loader_lock ();
+	/*
+	 * Building the signature description allocates, and almost all icalls are
+	 * registered without one, so only do it when a lookup needs it.
+	 */
+	if (icall_hash_has_signatures) {
+		if (!append_icall_signature (method, mname, sizeof (mname), sigstart))
+			return NULL;
+		have_sig = TRUE;
+	}
 
-	res = g_hash_table_lookup (icall_hash, mname);
-	if (res) {
-		mono_loader_unlock ();
-		return res;
+	mono_icall_lock ();
+	res = have_sig ? g_hash_table_lookup (icall_hash, mname) : NULL;
+	if (!res) {
+		/* try without signature */
+		*sigstart = 0;
+		res = g_hash_table_lookup (icall_hash, mname);
 	}
-	/* try without signature */
-	*sigstart = 0;
-	res = g_hash_table_lookup (icall_hash, mname);
-	if (res) {
-		mono_loader_unlock ();
+	mono_icall_unlock ();
+	if (res)
 		return res;
-	}
 
 #ifdef DISABLE_ICALL_TABLES
-	mono_loader_unlock ();
 	/* Fail only when the result is actually used */
 	/* mono_marshal_get_native_wrapper () depends on this */
 	if (method->klass == mono_defaults.string_class && !strcmp (method->name, ".ctor"))
@@ -8109,23 +8140,19 @@ mono_lookup_internal_call (MonoMethod *method)
 	else
 		return no_icall_table;
 #else
-	/* it wasn't found in the static call tables */
-	if (!imap) {
-		mono_loader_unlock ();
+	/* The static tables are read-only, so no locking is needed from here on */
+	if (!imap)
 		return NULL;
-	}
 	res = find_method_icall (imap, sigstart - mlen);
-	if (res) {
-		mono_loader_unlock ();
+	if (res)
 		return res;
-	}
 	/* try _with_ signature */
+	if (!have_sig && !append_icall_signature (method, mname, sizeof (mname), sigstart))
+		return NULL;
 	*sigstart = '(';
 	res = find_method_icall (imap, sigstart - mlen);
-	if (res) {
-		mono_loader_unlock ();
+	if (res)
 		return res;
-	}
 
 	g_warning ("cant resolve internal call to \"%s\" (tested without signature also)", mname);
 	g_print ("\nYour mono runtime and class libraries are out of sync.\n");
@@ -8135,8 +8162,6 @@ mono_lookup_internal_call (MonoMethod *method)
 	g_print ("If you see other errors or faults after this message they are probably related\n");
 	g_print ("and you need to fix your mono install first.\n");
 
-	mono_loader_unlock ();
-
 	return NULL;
 #endif
 }
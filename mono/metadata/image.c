@@ -1613,7 +1613,10 @@ mono_image_close_except_pools (MonoImage *image)
 		g_hash_table_foreach (image->name_cache, free_hash_table, NULL);
 		g_hash_table_destroy (image->name_cache);
 	}
+	g_free (image->class_name_index);
+	mono_custom_attrs_free_image_cache (image);
 
+	mono_marshal_invalidate_wrapper_lookups ();
 	free_hash (image->native_wrapper_cache);
 	free_hash (image->managed_wrapper_cache);
 	free_hash (image->delegate_begin_invoke_cache);
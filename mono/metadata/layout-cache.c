@@ -0,0 +1,996 @@
+/*
+ * layout-cache.c: On disk cache of class layouts
+ *
+ *   The results of laying out a class (instance and static sizes, field offsets, the
+ * GC reference bitmap, the interface offsets and the vtable) only depend on the
+ * metadata of the assemblies involved, but they are computed again by every process.
+ * When MONO_LAYOUT_CACHE points to a directory, these results are saved there at
+ * shutdown, in one file per assembly, and the next process maps that file and uses
+ * its entries instead of computing them again.
+ *
+ * The files are named after the MVID of the assembly, and their header contains the
+ * MVID of corlib and a hash of the runtime build, so a rebuilt assembly, corlib or
+ * runtime invalidates them. Only classes whose layout depends on nothing but their
+ * own assembly and corlib are cached, which is what makes checking those MVIDs
+ * enough. Generic classes, interfaces and classes with special static fields are not
+ * cached either.
+ *
+ * Entries are sequences of guint32 values, see encode_entry () for their format.
+ *
+ * Lookups don't take any lock: the LayoutCacheImage of an image is published in
+ * MonoImage->layout_cache once its file is loaded, and neither the structure nor the
+ * mapping change or go away until the image is closed. Writing a new file at shutdown
+ * leaves the mapping of the old one alone.
+ *
+ * Copyright 2013 Xamarin, Inc (http://www.xamarin.com)
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <mono/metadata/layout-cache.h>
+#include <mono/metadata/class-internals.h>
+#include <mono/metadata/metadata-internals.h>
+#include <mono/metadata/object-internals.h>
+#include <mono/metadata/tabledefs.h>
+#include <mono/metadata/tokentype.h>
+#include <mono/metadata/security-manager.h>
+#include <mono/metadata/security-core-clr.h>
+#include <mono/io-layer/io-layer.h>
+#include <mono/utils/mono-mmap.h>
+#include <mono/utils/mono-counters.h>
+#include <mono/utils/mono-memory-model.h>
+
+#define LAYOUT_CACHE_VERSION 1
+
+/* How deep valuetype fields are followed when checking which assemblies a layout depends on */
+#define MAX_FIELD_DEPTH 8
+
+typedef struct {
+	char magic [4];
+	guint32 version;
+	guint32 pointer_size;
+	guint32 build_hash;
+	char guid [40];
+	char corlib_guid [40];
+	guint32 num_types;
+	/* Followed by the offset of the entry of each typedef row, or 0 */
+} LayoutCacheHeader;
+
+/* The fixed part of an entry */
+enum {
+	ENTRY_LENGTH,
+	ENTRY_FLAGS,
+	ENTRY_VTABLE_SIZE,
+	ENTRY_CCTOR_TOKEN,
+	ENTRY_FINALIZE_IMAGE,
+	ENTRY_FINALIZE_TOKEN,
+	ENTRY_INSTANCE_SIZE,
+	ENTRY_CLASS_SIZE,
+	ENTRY_PACKING_SIZE,
+	ENTRY_MIN_ALIGN,
+	ENTRY_HEADER_SIZE
+};
+
+enum {
+	FLAG_GHCIMPL = 1 << 0,
+	FLAG_HAS_FINALIZE = 1 << 1,
+	FLAG_HAS_CCTOR = 1 << 2,
+	FLAG_HAS_NESTED_CLASSES = 1 << 3,
+	FLAG_BLITTABLE = 1 << 4,
+	FLAG_HAS_REFERENCES = 1 << 5,
+	FLAG_HAS_STATIC_REFS = 1 << 6,
+	FLAG_NO_SPECIAL_STATIC_FIELDS = 1 << 7,
+	FLAG_HAS_VTABLE = 1 << 8
+};
+
+/* Images referenced by an entry */
+enum {
+	REF_SELF,
+	REF_CORLIB
+};
+
+typedef struct {
+	MonoImage *image;
+	char *path;
+	char *guid;
+	char *corlib_guid;
+	guint32 num_types;
+	/* The cache file, NULL if there is none or it is out of date. Immutable once published */
+	guint8 *data;
+	guint32 data_size;
+	/* NULL if DATA was read instead of mapped */
+	gpointer map_handle;
+	/* Classes whose vtable was created and which are not in the file, protected by the lock */
+	GHashTable *pending;
+} LayoutCacheImage;
+
+/* A decoded entry, the arrays point into the mapped file */
+typedef struct {
+	const guint32 *header;
+	guint32 num_fields;
+	const guint32 *field_offsets;
+	guint32 gc_bits, gc_words;
+	const guint32 *gc_bitmap;
+	guint32 num_interfaces;
+	const guint32 *interfaces;
+	guint32 num_vtable_slots;
+	const guint32 *vtable;
+	guint32 num_method_slots;
+	const guint32 *method_slots;
+} LayoutCacheEntry;
+
+static gboolean enabled;
+static char *cache_dir;
+static guint32 build_hash;
+static int layout_cache_hits, layout_cache_misses;
+/* The LayoutCacheImage structures whose classes still need to be saved */
+static GSList *cache_images;
+
+/* This protects CACHE_IMAGES, the creation of LayoutCacheImage structures and their PENDING tables */
+#define layout_cache_lock() EnterCriticalSection (&layout_cache_mutex)
+#define layout_cache_unlock() LeaveCriticalSection (&layout_cache_mutex)
+static CRITICAL_SECTION layout_cache_mutex;
+
+static void flush_cache_image (LayoutCacheImage *cimage);
+
+static void
+free_cache_image (LayoutCacheImage *cimage)
+{
+	if (cimage->map_handle)
+		mono_file_unmap (cimage->data, cimage->map_handle);
+	else
+		g_free (cimage->data);
+	g_hash_table_destroy (cimage->pending);
+	g_free (cimage->path);
+	g_free (cimage->guid);
+	g_free (cimage->corlib_guid);
+	g_free (cimage);
+}
+
+/*
+ * image_unloaded:
+ *
+ *   Called when IMAGE is closed, at which point no class of IMAGE can be looked up
+ * anymore, so its data can be unmapped.
+ */
+static void
+image_unloaded (MonoImage *image, gpointer user_data)
+{
+	LayoutCacheImage *cimage;
+	gboolean flush = FALSE;
+
+	layout_cache_lock ();
+	cimage = image->layout_cache;
+	image->layout_cache = NULL;
+	if (cimage && g_slist_find (cache_images, cimage)) {
+		cache_images = g_slist_remove (cache_images, cimage);
+		flush = TRUE;
+	}
+	layout_cache_unlock ();
+
+	if (cimage) {
+		if (flush)
+			flush_cache_image (cimage);
+		free_cache_image (cimage);
+	}
+}
+
+/**
+ * mono_layout_cache_init:
+ * @runtime_build_info: a string identifying the runtime build
+ *
+ *   Enable the layout cache if MONO_LAYOUT_CACHE is set.
+ */
+void
+mono_layout_cache_init (const char *runtime_build_info)
+{
+	const char *dir = g_getenv ("MONO_LAYOUT_CACHE");
+
+	if (!dir || !*dir)
+		return;
+
+	cache_dir = g_strdup (dir);
+	build_hash = g_str_hash (runtime_build_info);
+	InitializeCriticalSection (&layout_cache_mutex);
+	mono_install_image_unload_hook (image_unloaded, NULL);
+	mono_counters_register ("Layout cache hits", MONO_COUNTER_INT|MONO_COUNTER_METADATA, &layout_cache_hits);
+	mono_counters_register ("Layout cache misses", MONO_COUNTER_INT|MONO_COUNTER_METADATA, &layout_cache_misses);
+	enabled = TRUE;
+}
+
+/**
+ * mono_layout_cache_cleanup:
+ *
+ *   Save the classes laid out by this process for the images which are still loaded.
+ * This must be called before the images are closed. Other threads might still look
+ * up classes, so the cached data is only freed when the images are closed.
+ */
+void
+mono_layout_cache_cleanup (void)
+{
+	GSList *images, *l;
+
+	if (!enabled)
+		return;
+
+	layout_cache_lock ();
+	images = cache_images;
+	cache_images = NULL;
+	/* No new classes are added to the PENDING tables from now on */
+	enabled = FALSE;
+	layout_cache_unlock ();
+
+	for (l = images; l; l = l->next)
+		flush_cache_image (l->data);
+	g_slist_free (images);
+}
+
+static gboolean
+class_is_candidate (MonoClass *klass)
+{
+	MonoImage *image = klass->image;
+
+	if (!enabled)
+		return FALSE;
+	if (image->dynamic || image->uncompressed_metadata || !image->guid)
+		return FALSE;
+	if (!mono_defaults.corlib || !mono_defaults.corlib->guid)
+		return FALSE;
+	if (klass->rank || klass->generic_class || klass->generic_container || MONO_CLASS_IS_INTERFACE (klass))
+		return FALSE;
+	if (mono_metadata_token_table (klass->type_token) != MONO_TABLE_TYPEDEF || !mono_metadata_token_index (klass->type_token))
+		return FALSE;
+	/* The cached vtables skip the security checks done while building them */
+	if (mono_security_get_mode () != MONO_SECURITY_MODE_NONE || mono_is_security_manager_active ())
+		return FALSE;
+	return TRUE;
+}
+
+static gboolean
+header_is_valid (LayoutCacheImage *cimage)
+{
+	LayoutCacheHeader *header = (LayoutCacheHeader*)cimage->data;
+
+	if (cimage->data_size < sizeof (LayoutCacheHeader))
+		return FALSE;
+	if (memcmp (header->magic, "MLC", 4) || header->version != LAYOUT_CACHE_VERSION)
+		return FALSE;
+	if (header->pointer_size != sizeof (gpointer) || header->build_hash != build_hash)
+		return FALSE;
+	if (strncmp (header->guid, cimage->guid, sizeof (header->guid)) || strncmp (header->corlib_guid, cimage->corlib_guid, sizeof (header->corlib_guid)))
+		return FALSE;
+	if (header->num_types != cimage->num_types)
+		return FALSE;
+	if ((cimage->data_size - sizeof (LayoutCacheHeader)) / sizeof (guint32) < header->num_types)
+		return FALSE;
+	return TRUE;
+}
+
+static void
+load_cache_file (LayoutCacheImage *cimage)
+{
+#ifdef HOST_WIN32
+	gchar *contents;
+	gsize size;
+
+	/* A mapped file can't be replaced on windows, so read it instead */
+	if (!g_file_get_contents (cimage->path, &contents, &size, NULL))
+		return;
+	if (size >= sizeof (LayoutCacheHeader) && size < G_MAXUINT32) {
+		cimage->data = (guint8*)contents;
+		cimage->data_size = size;
+	} else {
+		g_free (contents);
+	}
+#else
+	MonoFileMap *file;
+	guint64 size;
+
+	file = mono_file_map_open (cimage->path);
+	if (!file)
+		return;
+
+	size = mono_file_map_size (file);
+	if (size >= sizeof (LayoutCacheHeader) && size < G_MAXUINT32) {
+		cimage->data = mono_file_map (size, MONO_MMAP_READ | MONO_MMAP_PRIVATE, mono_file_map_fd (file), 0, &cimage->map_handle);
+		cimage->data_size = size;
+	}
+	mono_file_map_close (file);
+#endif
+
+	if (cimage->data && !header_is_valid (cimage)) {
+		if (cimage->map_handle)
+			mono_file_unmap (cimage->data, cimage->map_handle);
+		else
+			g_free (cimage->data);
+		cimage->data = NULL;
+		cimage->map_handle = NULL;
+	}
+}
+
+/*
+ * get_cache_image:
+ *
+ *   Return the LayoutCacheImage of IMAGE, loading its cache file the first time.
+ */
+static LayoutCacheImage*
+get_cache_image (MonoImage *image)
+{
+	LayoutCacheImage *cimage;
+
+	cimage = image->layout_cache;
+	if (cimage)
+		return cimage;
+
+	layout_cache_lock ();
+	cimage = image->layout_cache;
+	if (cimage) {
+		layout_cache_unlock ();
+		return cimage;
+	}
+
+	cimage = g_new0 (LayoutCacheImage, 1);
+	cimage->image = image;
+	cimage->guid = g_strdup (image->guid);
+	cimage->corlib_guid = g_strdup (mono_defaults.corlib->guid);
+	cimage->num_types = image->tables [MONO_TABLE_TYPEDEF].rows;
+	cimage->path = g_strdup_printf ("%s%c%s-%s.layout", cache_dir, G_DIR_SEPARATOR, image->assembly_name ? image->assembly_name : image->module_name, image->guid);
+	cimage->pending = g_hash_table_new (NULL, NULL);
+	load_cache_file (cimage);
+
+	cache_images = g_slist_prepend (cache_images, cimage);
+	/* Readers don't take the lock */
+	mono_memory_barrier ();
+	image->layout_cache = cimage;
+	layout_cache_unlock ();
+	return cimage;
+}
+
+static const guint32*
+lookup_entry (LayoutCacheImage *cimage, MonoClass *klass)
+{
+	const guint32 *offsets, *entry;
+	guint32 offset;
+
+	if (!cimage->data)
+		return NULL;
+
+	offsets = (const guint32*)(cimage->data + sizeof (LayoutCacheHeader));
+	offset = offsets [mono_metadata_token_index (klass->type_token) - 1];
+	if (!offset || (offset & 3) || offset > cimage->data_size - ENTRY_HEADER_SIZE * sizeof (guint32))
+		return NULL;
+
+	entry = (const guint32*)(cimage->data + offset);
+	if (entry [ENTRY_LENGTH] < ENTRY_HEADER_SIZE || entry [ENTRY_LENGTH] > (cimage->data_size - offset) / sizeof (guint32))
+		return NULL;
+	return entry;
+}
+
+static gboolean
+decode_array (const guint32 **p, const guint32 *end, int elem_size, guint32 *count, const guint32 **array)
+{
+	if (*p >= end)
+		return FALSE;
+	*count = *(*p)++;
+	if (*count > (end - *p) / elem_size)
+		return FALSE;
+	*array = *p;
+	*p += *count * elem_size;
+	return TRUE;
+}
+
+/*
+ * find_entry:
+ *
+ *   Find and decode the cache entry of KLASS. Return FALSE if there is none.
+ * The cache file stays around until the image of KLASS is unloaded.
+ */
+static gboolean
+find_entry (MonoClass *klass, LayoutCacheEntry *e)
+{
+	const guint32 *entry, *p, *end;
+
+	if (!class_is_candidate (klass))
+		return FALSE;
+
+	entry = lookup_entry (get_cache_image (klass->image), klass);
+	if (!entry) {
+		++layout_cache_misses;
+		return FALSE;
+	}
+	++layout_cache_hits;
+
+	memset (e, 0, sizeof (LayoutCacheEntry));
+	e->header = entry;
+	p = entry + ENTRY_HEADER_SIZE;
+	end = entry + entry [ENTRY_LENGTH];
+
+	if (!decode_array (&p, end, 1, &e->num_fields, &e->field_offsets))
+		return FALSE;
+	if (p >= end)
+		return FALSE;
+	e->gc_bits = *p++;
+	if (!decode_array (&p, end, 1, &e->gc_words, &e->gc_bitmap) || e->gc_words != (e->gc_bits + 31) / 32)
+		return FALSE;
+	if (!decode_array (&p, end, 3, &e->num_interfaces, &e->interfaces))
+		return FALSE;
+	if (!decode_array (&p, end, 2, &e->num_vtable_slots, &e->vtable))
+		return FALSE;
+	if (!decode_array (&p, end, 2, &e->num_method_slots, &e->method_slots))
+		return FALSE;
+	return TRUE;
+}
+
+static MonoImage*
+decode_image_ref (MonoClass *klass, guint32 ref)
+{
+	switch (ref) {
+	case REF_SELF:
+		return klass->image;
+	case REF_CORLIB:
+		return mono_defaults.corlib;
+	default:
+		return NULL;
+	}
+}
+
+/**
+ * mono_layout_cache_get_class_info:
+ *
+ *   Same as the get_cached_class_info hook of the AOT runtime, for classes in the
+ * layout cache.
+ */
+gboolean
+mono_layout_cache_get_class_info (MonoClass *klass, MonoCachedClassInfo *res)
+{
+	LayoutCacheEntry e;
+	guint32 flags;
+
+	if (!find_entry (klass, &e))
+		return FALSE;
+
+	flags = e.header [ENTRY_FLAGS];
+	memset (res, 0, sizeof (MonoCachedClassInfo));
+	res->vtable_size = e.header [ENTRY_VTABLE_SIZE];
+	res->ghcimpl = (flags & FLAG_GHCIMPL) ? 1 : 0;
+	res->has_finalize = (flags & FLAG_HAS_FINALIZE) ? 1 : 0;
+	res->has_cctor = (flags & FLAG_HAS_CCTOR) ? 1 : 0;
+	res->has_nested_classes = (flags & FLAG_HAS_NESTED_CLASSES) ? 1 : 0;
+	res->blittable = (flags & FLAG_BLITTABLE) ? 1 : 0;
+	res->has_references = (flags & FLAG_HAS_REFERENCES) ? 1 : 0;
+	res->has_static_refs = (flags & FLAG_HAS_STATIC_REFS) ? 1 : 0;
+	res->no_special_static_fields = (flags & FLAG_NO_SPECIAL_STATIC_FIELDS) ? 1 : 0;
+	res->cctor_token = e.header [ENTRY_CCTOR_TOKEN];
+	if (res->has_finalize) {
+		res->finalize_image = decode_image_ref (klass, e.header [ENTRY_FINALIZE_IMAGE]);
+		res->finalize_token = e.header [ENTRY_FINALIZE_TOKEN];
+		if (!res->finalize_image)
+			return FALSE;
+	}
+	res->instance_size = e.header [ENTRY_INSTANCE_SIZE];
+	res->class_size = e.header [ENTRY_CLASS_SIZE];
+	res->packing_size = e.header [ENTRY_PACKING_SIZE];
+	res->min_align = e.header [ENTRY_MIN_ALIGN];
+	return TRUE;
+}
+
+/**
+ * mono_layout_cache_get_field_layout:
+ *
+ *   Set the field offsets and the fields of KLASS computed by mono_class_layout_fields ()
+ * from the layout cache. Return FALSE if KLASS is not cached.
+ * LOCKING: Assumes the loader lock is held.
+ */
+gboolean
+mono_layout_cache_get_field_layout (MonoClass *klass)
+{
+	LayoutCacheEntry e;
+	guint32 flags;
+	int i;
+
+	if (!find_entry (klass, &e) || e.num_fields != klass->field.count)
+		return FALSE;
+
+	flags = e.header [ENTRY_FLAGS];
+	for (i = 0; i < klass->field.count; ++i)
+		klass->fields [i].offset = (gint32)e.field_offsets [i];
+	klass->has_references = (flags & FLAG_HAS_REFERENCES) ? 1 : 0;
+	klass->has_static_refs = (flags & FLAG_HAS_STATIC_REFS) ? 1 : 0;
+	klass->instance_size = e.header [ENTRY_INSTANCE_SIZE];
+	klass->min_align = e.header [ENTRY_MIN_ALIGN];
+	klass->sizes.class_size = e.header [ENTRY_CLASS_SIZE];
+
+	mono_memory_barrier ();
+	klass->size_inited = 1;
+	return TRUE;
+}
+
+/**
+ * mono_layout_cache_get_gc_bitmap:
+ *
+ *   Same as mono_class_compute_bitmap () for the instance fields of KLASS, using the
+ * layout cache. Return NULL if KLASS is not cached.
+ */
+gsize*
+mono_layout_cache_get_gc_bitmap (MonoClass *klass, gsize *bitmap, int size, int *max_set)
+{
+	LayoutCacheEntry e;
+	int i, bits_per_word = sizeof (gsize) * 8;
+
+	if (!find_entry (klass, &e) || !e.gc_bits)
+		return NULL;
+
+	if (e.gc_bits > size)
+		bitmap = g_new0 (gsize, (e.gc_bits + bits_per_word - 1) / bits_per_word);
+	else
+		memset (bitmap, 0, (size + 7) / 8);
+
+	for (i = 0; i < e.gc_bits; ++i) {
+		if (e.gc_bitmap [i / 32] & (1 << (i % 32)))
+			bitmap [i / bits_per_word] |= ((gsize)1) << (i % bits_per_word);
+	}
+	*max_set = e.gc_bits - 1;
+	return bitmap;
+}
+
+/**
+ * mono_layout_cache_get_interface_offsets:
+ *
+ *   Return the interfaces implemented by KLASS and their vtable offsets, as computed by
+ * setup_interface_offsets (), from the layout cache. The interfaces are initialized.
+ * The arrays stored into INTERFACES and OFFSETS should be freed with g_free ().
+ */
+gboolean
+mono_layout_cache_get_interface_offsets (MonoClass *klass, MonoClass ***interfaces, int **offsets, int *count)
+{
+	LayoutCacheEntry e;
+	MonoClass **ifaces;
+	MonoImage *image;
+	int i;
+
+	if (!find_entry (klass, &e))
+		return FALSE;
+
+	ifaces = g_new0 (MonoClass*, e.num_interfaces);
+	for (i = 0; i < e.num_interfaces; ++i) {
+		image = decode_image_ref (klass, e.interfaces [i * 3]);
+		ifaces [i] = image ? mono_class_get (image, e.interfaces [i * 3 + 1]) : NULL;
+		if (!ifaces [i] || !MONO_CLASS_IS_INTERFACE (ifaces [i]) || !mono_class_init (ifaces [i])) {
+			mono_loader_clear_error ();
+			g_free (ifaces);
+			return FALSE;
+		}
+	}
+
+	*interfaces = ifaces;
+	*offsets = g_new (int, e.num_interfaces);
+	for (i = 0; i < e.num_interfaces; ++i)
+		(*offsets) [i] = e.interfaces [i * 3 + 2];
+	*count = e.num_interfaces;
+	return TRUE;
+}
+
+/**
+ * mono_layout_cache_get_vtable:
+ *
+ *   Return the vtable computed by mono_class_setup_vtable_general () for KLASS from the
+ * layout cache, and set the slot of the virtual methods of KLASS like it does. The
+ * result should be freed with g_free ().
+ * LOCKING: Assumes the loader lock is held.
+ */
+MonoMethod**
+mono_layout_cache_get_vtable (MonoClass *klass, int *vtable_size)
+{
+	LayoutCacheEntry e;
+	MonoMethod **vtable, *m;
+	MonoImage *image;
+	int i;
+
+	if (!find_entry (klass, &e) || !(e.header [ENTRY_FLAGS] & FLAG_HAS_VTABLE))
+		return NULL;
+
+	vtable = g_new0 (MonoMethod*, e.num_vtable_slots);
+	for (i = 0; i < e.num_vtable_slots; ++i) {
+		if (!e.vtable [i * 2 + 1])
+			continue;
+		image = decode_image_ref (klass, e.vtable [i * 2]);
+		vtable [i] = image ? mono_get_method (image, e.vtable [i * 2 + 1], NULL) : NULL;
+		if (!vtable [i]) {
+			mono_loader_clear_error ();
+			g_free (vtable);
+			return NULL;
+		}
+	}
+
+	for (i = 0; i < e.num_method_slots; ++i) {
+		m = mono_get_method (klass->image, e.method_slots [i * 2], klass);
+		if (!m || m->klass != klass) {
+			mono_loader_clear_error ();
+			g_free (vtable);
+			return NULL;
+		}
+		m->slot = (gint32)e.method_slots [i * 2 + 1];
+	}
+
+	*vtable_size = e.num_vtable_slots;
+	return vtable;
+}
+
+/**
+ * mono_layout_cache_add_class:
+ *
+ *   Called once the runtime vtable of KLASS is created, at which point it is laid
+ * out. KLASS is added to the cache file of its image when the image is unloaded or
+ * at shutdown, if it isn't in it already.
+ */
+void
+mono_layout_cache_add_class (MonoClass *klass)
+{
+	LayoutCacheImage *cimage;
+
+	if (!class_is_candidate (klass))
+		return;
+
+	cimage = get_cache_image (klass->image);
+	if (lookup_entry (cimage, klass))
+		return;
+
+	layout_cache_lock ();
+	if (enabled)
+		g_hash_table_insert (cimage->pending, klass, klass);
+	layout_cache_unlock ();
+}
+
+static int
+encode_image_ref (MonoClass *klass, MonoImage *image)
+{
+	if (image == klass->image)
+		return REF_SELF;
+	if (image == mono_defaults.corlib)
+		return REF_CORLIB;
+	return -1;
+}
+
+static gboolean fields_are_local (MonoClass *klass, MonoClass *fklass, gboolean statics, int depth);
+
+/*
+ * type_is_local:
+ *
+ *   Return whenever the size and the layout of TYPE only depend on the image of
+ * KLASS and corlib.
+ */
+static gboolean
+type_is_local (MonoClass *klass, MonoType *type, int depth)
+{
+	MonoClass *fklass;
+
+	if (type->byref || MONO_TYPE_IS_REFERENCE (type))
+		return TRUE;
+	if (type->type != MONO_TYPE_VALUETYPE && type->type != MONO_TYPE_GENERICINST)
+		return TRUE;
+
+	fklass = mono_class_from_mono_type (type);
+	if (!fklass || fklass->generic_class || fklass->generic_container || encode_image_ref (klass, fklass->image) == -1)
+		return FALSE;
+	if (depth >= MAX_FIELD_DEPTH)
+		return FALSE;
+	return fields_are_local (klass, fklass, FALSE, depth + 1);
+}
+
+static gboolean
+fields_are_local (MonoClass *klass, MonoClass *fklass, gboolean statics, int depth)
+{
+	MonoClassField *field;
+	int i;
+
+	if (fklass->field.count && !fklass->fields)
+		return FALSE;
+
+	for (i = 0; i < fklass->field.count; ++i) {
+		field = &fklass->fields [i];
+		if (!field->type)
+			return FALSE;
+		if (!statics && (field->type->attrs & FIELD_ATTRIBUTE_STATIC))
+			continue;
+		if (!type_is_local (klass, field->type, depth))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+method_is_local (MonoClass *klass, MonoMethod *m)
+{
+	return !m->is_inflated && m->wrapper_type == MONO_WRAPPER_NONE && !m->klass->generic_class &&
+		mono_metadata_token_table (m->token) == MONO_TABLE_METHOD && encode_image_ref (klass, m->klass->image) != -1;
+}
+
+static void
+emit (GArray *buf, guint32 value)
+{
+	g_array_append_val (buf, value);
+}
+
+/*
+ * encode_entry:
+ *
+ *   Encode the layout of KLASS, or return NULL if it can't be cached. The entry has
+ * the following format:
+ * - the ENTRY_HEADER_SIZE values of the enum above
+ * - the number of fields, followed by their offsets
+ * - the number of bits in the GC bitmap of the instance fields, the number of
+ *   guint32 words needed to hold it, followed by these words
+ * - the number of implemented interfaces, followed by an image ref, the typedef
+ *   token and the vtable offset for each one
+ * - the vtable size (0 if the vtable wasn't set up), followed by an image ref and a
+ *   methoddef token for each slot, or 0, 0 for empty slots
+ * - the number of virtual methods of KLASS, followed by the methoddef token and the
+ *   slot of each one
+ */
+static GArray*
+encode_entry (MonoClass *klass)
+{
+	MonoImage *image = klass->image;
+	MonoClassField *field;
+	MonoClass *ic;
+	MonoMethod *m;
+	GArray *buf;
+	gsize default_bitmap [4] = {0};
+	gsize *bitmap;
+	guint32 flags, word, count_index, num_slots;
+	int i, j, bit, max_set = 0, num_bits, bits_per_word = sizeof (gsize) * 8;
+	gboolean has_vtable = klass->vtable != NULL;
+
+	if (klass->exception_type || !klass->inited || !klass->size_inited || !klass->fields_inited || !klass->interfaces_packed)
+		return NULL;
+
+	/* The layout of every supertype must be local too */
+	for (i = 0; i < klass->idepth; ++i) {
+		MonoClass *k = klass->supertypes [i];
+
+		if (k->generic_class || encode_image_ref (klass, k->image) == -1 || !fields_are_local (klass, k, k == klass, 0))
+			return NULL;
+	}
+
+	mono_class_has_finalizer (klass);
+
+	buf = g_array_new (FALSE, TRUE, sizeof (guint32));
+	g_array_set_size (buf, ENTRY_HEADER_SIZE);
+
+	/* Special static fields get offset -1 when the runtime vtable is created, these are not cached */
+	flags = FLAG_NO_SPECIAL_STATIC_FIELDS;
+	if (klass->ghcimpl)
+		flags |= FLAG_GHCIMPL;
+	if (klass->has_finalize)
+		flags |= FLAG_HAS_FINALIZE;
+	if (klass->has_cctor)
+		flags |= FLAG_HAS_CCTOR;
+	if (!klass->nested_classes_inited || (klass->ext && klass->ext->nested_classes))
+		flags |= FLAG_HAS_NESTED_CLASSES;
+	if (klass->blittable)
+		flags |= FLAG_BLITTABLE;
+	if (klass->has_references)
+		flags |= FLAG_HAS_REFERENCES;
+	if (klass->has_static_refs)
+		flags |= FLAG_HAS_STATIC_REFS;
+	if (has_vtable)
+		flags |= FLAG_HAS_VTABLE;
+	g_array_index (buf, guint32, ENTRY_FLAGS) = flags;
+	g_array_index (buf, guint32, ENTRY_VTABLE_SIZE) = klass->vtable_size;
+
+	if (klass->has_cctor) {
+		m = mono_class_get_cctor (klass);
+		if (!m || m->klass != klass || !method_is_local (klass, m))
+			goto fail;
+		g_array_index (buf, guint32, ENTRY_CCTOR_TOKEN) = m->token;
+	}
+	if (klass->has_finalize) {
+		m = mono_class_get_finalizer (klass);
+		if (!m || !method_is_local (klass, m))
+			goto fail;
+		g_array_index (buf, guint32, ENTRY_FINALIZE_IMAGE) = encode_image_ref (klass, m->klass->image);
+		g_array_index (buf, guint32, ENTRY_FINALIZE_TOKEN) = m->token;
+	}
+
+	g_array_index (buf, guint32, ENTRY_INSTANCE_SIZE) = klass->instance_size;
+	g_array_index (buf, guint32, ENTRY_CLASS_SIZE) = mono_class_data_size (klass);
+	g_array_index (buf, guint32, ENTRY_PACKING_SIZE) = klass->packing_size;
+	g_array_index (buf, guint32, ENTRY_MIN_ALIGN) = klass->min_align;
+
+	emit (buf, klass->field.count);
+	for (i = 0; i < klass->field.count; ++i) {
+		field = &klass->fields [i];
+		if ((field->type->attrs & FIELD_ATTRIBUTE_STATIC) && !(field->type->attrs & FIELD_ATTRIBUTE_LITERAL) && field->offset == -1)
+			goto fail;
+		emit (buf, field->offset);
+	}
+
+	bitmap = mono_class_compute_bitmap (klass, default_bitmap, sizeof (default_bitmap) * 8, 0, &max_set, FALSE);
+	num_bits = max_set + 1;
+	emit (buf, num_bits);
+	emit (buf, (num_bits + 31) / 32);
+	for (i = 0; i < num_bits; i += 32) {
+		word = 0;
+		for (j = 0; j < 32; ++j) {
+			bit = i + j;
+			if (bit < num_bits && (bitmap [bit / bits_per_word] & (((gsize)1) << (bit % bits_per_word))))
+				word |= 1 << j;
+		}
+		emit (buf, word);
+	}
+	if (bitmap != default_bitmap)
+		g_free (bitmap);
+
+	emit (buf, klass->interface_offsets_count);
+	for (i = 0; i < klass->interface_offsets_count; ++i) {
+		ic = klass->interfaces_packed [i];
+		if (ic->generic_class || mono_metadata_token_table (ic->type_token) != MONO_TABLE_TYPEDEF || encode_image_ref (klass, ic->image) == -1)
+			goto fail;
+		emit (buf, encode_image_ref (klass, ic->image));
+		emit (buf, ic->type_token);
+		emit (buf, klass->interface_offsets_packed [i]);
+	}
+
+	emit (buf, has_vtable ? klass->vtable_size : 0);
+	for (i = 0; has_vtable && i < klass->vtable_size; ++i) {
+		m = klass->vtable [i];
+		if (m && !method_is_local (klass, m))
+			goto fail;
+		emit (buf, m ? encode_image_ref (klass, m->klass->image) : 0);
+		emit (buf, m ? m->token : 0);
+	}
+
+	count_index = buf->len;
+	num_slots = 0;
+	emit (buf, 0);
+	for (i = 0; has_vtable && i < klass->method.count; ++i) {
+		int idx = klass->method.first + i;
+		guint32 token = MONO_TOKEN_METHOD_DEF | (idx + 1);
+
+		if (!(mono_metadata_decode_row_col (&image->tables [MONO_TABLE_METHOD], idx, MONO_METHOD_FLAGS) & METHOD_ATTRIBUTE_VIRTUAL))
+			continue;
+		m = mono_get_method (image, token, klass);
+		if (!m || m->slot < 0)
+			goto fail;
+		emit (buf, token);
+		emit (buf, m->slot);
+		num_slots ++;
+	}
+	g_array_index (buf, guint32, count_index) = num_slots;
+
+	g_array_index (buf, guint32, ENTRY_LENGTH) = buf->len;
+	return buf;
+
+fail:
+	mono_loader_clear_error ();
+	g_array_free (buf, TRUE);
+	return NULL;
+}
+
+static void
+write_cache_file (LayoutCacheImage *cimage, GArray **new_entries)
+{
+	LayoutCacheHeader header;
+	guint32 *offsets;
+	const guint32 *entry;
+	GArray *entries;
+	char *tmp_path;
+	FILE *f;
+	gboolean ok;
+	guint32 base;
+	int i;
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, "MLC", 4);
+	header.version = LAYOUT_CACHE_VERSION;
+	header.pointer_size = sizeof (gpointer);
+	header.build_hash = build_hash;
+	strncpy (header.guid, cimage->guid, sizeof (header.guid) - 1);
+	strncpy (header.corlib_guid, cimage->corlib_guid, sizeof (header.corlib_guid) - 1);
+	header.num_types = cimage->num_types;
+
+	/* Merge the new entries with the ones from the old file */
+	base = sizeof (LayoutCacheHeader) + cimage->num_types * sizeof (guint32);
+	offsets = g_new0 (guint32, cimage->num_types);
+	entries = g_array_new (FALSE, FALSE, sizeof (guint32));
+	for (i = 0; i < cimage->num_types; ++i) {
+		if (new_entries [i]) {
+			entry = (const guint32*)new_entries [i]->data;
+		} else if (cimage->data) {
+			guint32 offset = ((const guint32*)(cimage->data + sizeof (LayoutCacheHeader))) [i];
+
+			entry = NULL;
+			if (offset && !(offset & 3) && offset <= cimage->data_size - ENTRY_HEADER_SIZE * sizeof (guint32)) {
+				entry = (const guint32*)(cimage->data + offset);
+				if (entry [ENTRY_LENGTH] < ENTRY_HEADER_SIZE || entry [ENTRY_LENGTH] > (cimage->data_size - offset) / sizeof (guint32))
+					entry = NULL;
+			}
+		} else {
+			entry = NULL;
+		}
+		if (!entry)
+			continue;
+		offsets [i] = base + entries->len * sizeof (guint32);
+		g_array_append_vals (entries, entry, entry [ENTRY_LENGTH]);
+	}
+
+	/*
+	 * Write to a temporary file first, so other processes never map a partial file. The
+	 * old file stays mapped by this process, lookups might still read it.
+	 */
+	g_mkdir_with_parents (cache_dir, 0755);
+	tmp_path = g_strdup_printf ("%s.%d.tmp", cimage->path, getpid ());
+	f = fopen (tmp_path, "wb");
+	if (f) {
+		ok = fwrite (&header, sizeof (header), 1, f) == 1;
+		ok = ok && (!cimage->num_types || fwrite (offsets, sizeof (guint32), cimage->num_types, f) == cimage->num_types);
+		ok = ok && (!entries->len || fwrite (entries->data, sizeof (guint32), entries->len, f) == entries->len);
+		ok = (fclose (f) == 0) && ok;
+#ifdef HOST_WIN32
+		if (ok)
+			g_unlink (cimage->path);
+#endif
+		if (!ok || g_rename (tmp_path, cimage->path) != 0)
+			g_unlink (tmp_path);
+	}
+
+	g_free (tmp_path);
+	g_free (offsets);
+	g_array_free (entries, TRUE);
+}
+
+typedef struct {
+	GArray **new_entries;
+	gboolean added;
+} FlushData;
+
+static void
+encode_pending_class (gpointer key, gpointer value, gpointer user_data)
+{
+	MonoClass *klass = key;
+	FlushData *data = user_data;
+	GArray *entry;
+
+	entry = encode_entry (klass);
+	if (entry) {
+		data->new_entries [mono_metadata_token_index (klass->type_token) - 1] = entry;
+		data->added = TRUE;
+	}
+}
+
+/*
+ * flush_cache_image:
+ *
+ *   Write the cache file of CIMAGE again if classes were added to it.
+ */
+static void
+flush_cache_image (LayoutCacheImage *cimage)
+{
+	FlushData data;
+	int i;
+
+	if (!g_hash_table_size (cimage->pending))
+		return;
+
+	data.new_entries = g_new0 (GArray*, cimage->num_types);
+	data.added = FALSE;
+
+	mono_loader_lock ();
+	g_hash_table_foreach (cimage->pending, encode_pending_class, &data);
+	mono_loader_unlock ();
+
+	if (data.added)
+		write_cache_file (cimage, data.new_entries);
+
+	for (i = 0; i < cimage->num_types; ++i) {
+		if (data.new_entries [i])
+			g_array_free (data.new_entries [i], TRUE);
+	}
+	g_free (data.new_entries);
+}
@@ -0,0 +1,35 @@
+#ifndef __MONO_METADATA_LAYOUT_CACHE_H__
+#define __MONO_METADATA_LAYOUT_CACHE_H__
+
+#include <glib.h>
+#include <mono/metadata/class-internals.h>
+
+G_BEGIN_DECLS
+
+void
+mono_layout_cache_init (const char *runtime_build_info) MONO_INTERNAL;
+
+void
+mono_layout_cache_cleanup (void) MONO_INTERNAL;
+
+gboolean
+mono_layout_cache_get_class_info (MonoClass *klass, MonoCachedClassInfo *res) MONO_INTERNAL;
+
+gboolean
+mono_layout_cache_get_field_layout (MonoClass *klass) MONO_INTERNAL;
+
+gsize*
+mono_layout_cache_get_gc_bitmap (MonoClass *klass, gsize *bitmap, int size, int *max_set) MONO_INTERNAL;
+
+gboolean
+mono_layout_cache_get_interface_offsets (MonoClass *klass, MonoClass ***interfaces, int **offsets, int *count) MONO_INTERNAL;
+
+MonoMethod**
+mono_layout_cache_get_vtable (MonoClass *klass, int *vtable_size) MONO_INTERNAL;
+
+void
+mono_layout_cache_add_class (MonoClass *klass) MONO_INTERNAL;
+
+G_END_DECLS
+
+#endif  /* __MONO_METADATA_LAYOUT_CACHE_H__ */
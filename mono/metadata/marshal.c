@@ -74,10 +74,40 @@ typedef struct _MonoRemotingMethods MonoRemotingMethods;
  * Note that when this lock is held it is not possible to take other runtime
  * locks like the loader lock.
  */
-#define mono_marshal_lock() EnterCriticalSection (&marshal_mutex)
+#define mono_marshal_lock() do {							\
+		if (!TryEnterCriticalSection (&marshal_mutex)) {			\
+			InterlockedIncrement (&marshal_lock_contentions);		\
+			EnterCriticalSection (&marshal_mutex);				\
+		}									\
+	} while (0)
 #define mono_marshal_unlock() LeaveCriticalSection (&marshal_mutex)
 static CRITICAL_SECTION marshal_mutex;
 static gboolean marshal_mutex_initialized;
+static gint32 marshal_lock_contentions;
+
+/*
+ * Per-thread, direct mapped cache in front of the wrapper caches, so a thread
+ * asking again for a wrapper it already got doesn't need the marshal lock.
+ * Entries are only ever touched by their own thread. All of them are dropped
+ * when wrapper_lookup_generation changes, which happens before wrappers are
+ * removed from a cache and before an image frees its caches, so a reused key
+ * or cache address can't hit a stale entry.
+ */
+#define WRAPPER_LOOKUP_CACHE_SIZE 128
+
+typedef struct {
+	GHashTable *cache;
+	gpointer key;
+	MonoMethod *method;
+} WrapperLookupEntry;
+
+typedef struct {
+	gint32 generation;
+	WrapperLookupEntry entries [WRAPPER_LOOKUP_CACHE_SIZE];
+} WrapperLookupCache;
+
+static MonoNativeTlsKey wrapper_lookup_tls_id;
+static volatile gint32 wrapper_lookup_generation;
 
 static MonoNativeTlsKey last_error_tls_id;
 
@@ -215,6 +245,9 @@ mono_marshal_init (void)
 		marshal_mutex_initialized = TRUE;
 		mono_native_tls_alloc (&last_error_tls_id, NULL);
 		mono_native_tls_alloc (&load_type_info_tls_id, NULL);
+		mono_native_tls_alloc (&wrapper_lookup_tls_id, g_free);
+
+		mono_counters_register ("Marshal lock contentions", MONO_COUNTER_METADATA | MONO_COUNTER_INT, &marshal_lock_contentions);
 
 		register_icall (ves_icall_System_Threading_Thread_ResetAbort, "ves_icall_System_Threading_Thread_ResetAbort", "void", TRUE);
 		register_icall (mono_marshal_string_to_utf16, "mono_marshal_string_to_utf16", "ptr obj", FALSE);
@@ -278,6 +311,7 @@ mono_marshal_cleanup (void)
 {
 	mono_cominterop_cleanup ();
 
+	mono_native_tls_free (wrapper_lookup_tls_id);
 	mono_native_tls_free (load_type_info_tls_id);
 	mono_native_tls_free (last_error_tls_id);
 	DeleteCriticalSection (&marshal_mutex);
@@ -2437,14 +2471,56 @@ mono_marshal_get_cache (GHashTable **var, GHashFunc hash_func, GCompareFunc equa
 	return get_cache (var, hash_func, equal_func);
 }
 
+static WrapperLookupEntry*
+wrapper_lookup_entry (GHashTable *cache, gpointer key)
+{
+	WrapperLookupCache *lc = mono_native_tls_get_value (wrapper_lookup_tls_id);
+	gint32 generation = wrapper_lookup_generation;
+	guint32 hash;
+
+	if (!lc) {
+		lc = g_new0 (WrapperLookupCache, 1);
+		lc->generation = generation;
+		mono_native_tls_set_value (wrapper_lookup_tls_id, lc);
+	} else if (lc->generation != generation) {
+		memset (lc->entries, 0, sizeof (lc->entries));
+		lc->generation = generation;
+	}
+
+	hash = mono_aligned_addr_hash (cache) * 31 + mono_aligned_addr_hash (key);
+	return &lc->entries [hash & (WRAPPER_LOOKUP_CACHE_SIZE - 1)];
+}
+
+/*
+ * mono_marshal_invalidate_wrapper_lookups:
+ *
+ *   Drop the per-thread wrapper lookup caches. This must be called before
+ * wrappers are removed from a wrapper cache, or the cache itself is freed.
+ */
+void
+mono_marshal_invalidate_wrapper_lookups (void)
+{
+	InterlockedIncrement (&wrapper_lookup_generation);
+}
+
 MonoMethod*
 mono_marshal_find_in_cache (GHashTable *cache, gpointer key)
 {
+	WrapperLookupEntry *entry = wrapper_lookup_entry (cache, key);
 	MonoMethod *res;
 
+	if (entry->cache == cache && entry->key == key)
+		return entry->method;
+
 	mono_marshal_lock ();
 	res = g_hash_table_lookup (cache, key);
 	mono_marshal_unlock ();
+
+	if (res) {
+		entry->cache = cache;
+		entry->key = key;
+		entry->method = res;
+	}
 	return res;
 }
 
@@ -2454,8 +2530,12 @@ mono_mb_create_and_cache (GHashTable *cache, gpointer key,
 							   MonoMethodBuilder *mb, MonoMethodSignature *sig,
 							   int max_stack)
 {
+	WrapperLookupEntry *entry = wrapper_lookup_entry (cache, key);
 	MonoMethod *res;
 
+	if (entry->cache == cache && entry->key == key)
+		return entry->method;
+
 	mono_marshal_lock ();
 	res = g_hash_table_lookup (cache, key);
 	mono_marshal_unlock ();
@@ -2475,6 +2555,9 @@ mono_mb_create_and_cache (GHashTable *cache, gpointer key,
 		}
 	}
 
+	entry->cache = cache;
+	entry->key = key;
+	entry->method = res;
 	return res;
 }		
 
@@ -12784,6 +12867,7 @@ mono_marshal_free_dynamic_wrappers (MonoMethod *method)
 	/* This could be called during shutdown */
 	if (marshal_mutex_initialized)
 		mono_marshal_lock ();
+	mono_marshal_invalidate_wrapper_lookups ();
 	/* 
 	 * FIXME: We currently leak the wrappers. Freeing them would be tricky as
 	 * they could be shared with other methods ?
@@ -12825,6 +12909,7 @@ mono_marshal_free_inflated_wrappers (MonoMethod *method)
                return;
 
        mono_marshal_lock ();
+       mono_marshal_invalidate_wrapper_lookups ();
        /*
         * FIXME: We currently leak the wrappers. Freeing them would be tricky as
         * they could be shared with other methods ?
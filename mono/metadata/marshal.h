@@ -366,6 +366,9 @@ mono_marshal_get_gsharedvt_out_wrapper (void) MONO_INTERNAL;
 void
 mono_marshal_free_dynamic_wrappers (MonoMethod *method) MONO_INTERNAL;
 
+void
+mono_marshal_invalidate_wrapper_lookups (void) MONO_INTERNAL;
+
 void
 mono_marshal_free_inflated_wrappers (MonoMethod *method) MONO_INTERNAL;
 
@@ -103,6 +103,9 @@ typedef struct {
 	guint32  size;
 } MonoStreamHeader;
 
+/* The widest table (Assembly) has 9 columns */
+#define MONO_TABLE_MAX_COLUMNS 9
+
 struct _MonoTableInfo {
 	const char *base;
 	guint       rows     : 24;
@@ -119,6 +122,13 @@ struct _MonoTableInfo {
 	 * we only need 4, but 8 is aligned no shift required. 
 	 */
 	guint32   size_bitfield;
+
+	/*
+	 * Byte offset of each column inside a row, derived from size_bitfield
+	 * by mono_metadata_compute_column_offsets (), so single columns can be
+	 * read without walking the preceding ones.
+	 */
+	guint8    column_offsets [MONO_TABLE_MAX_COLUMNS];
 };
 
 #define REFERENCE_MISSING ((gpointer) -1)
@@ -205,6 +215,9 @@ struct _MonoImage {
 
 	gpointer aot_module;
 
+	/* The LayoutCacheImage of this image, see layout-cache.c */
+	gpointer layout_cache;
+
 	/*
 	 * The Assembly this image was loaded from.
 	 */
@@ -238,6 +251,19 @@ struct _MonoImage {
 	 */
 	GHashTable *name_cache;  /*protected by the image lock*/
 
+	/*
+	 * Immutable hash of the same names for non dynamic images, built on
+	 * first use and read without locking, see mono_class_from_name ().
+	 */
+	struct _MonoClassNameIndex *class_name_index;
+
+	/*
+	 * Decoded MonoCustomAttrInfo of non dynamic images, indexed by the coded
+	 * CustomAttribute parent index, with a presence filter in front. Built on
+	 * first use and read without locking, see mono_custom_attrs_from_index ().
+	 */
+	struct _MonoCustomAttrCache *cattr_cache;
+
 	/*
 	 * Indexed by MonoClass
 	 */
@@ -592,6 +618,7 @@ mono_metadata_cleanup (void);
 
 const char *   mono_meta_table_name              (int table) MONO_INTERNAL;
 void           mono_metadata_compute_table_bases (MonoImage *meta) MONO_INTERNAL;
+void           mono_metadata_compute_column_offsets (MonoTableInfo *table) MONO_INTERNAL;
 
 gboolean
 mono_metadata_interfaces_from_typedef_full  (MonoImage             *image,
@@ -672,6 +699,10 @@ void mono_assembly_release_gc_roots (MonoAssembly *assembly) MONO_INTERNAL;
 gboolean mono_assembly_close_except_image_pools (MonoAssembly *assembly) MONO_INTERNAL;
 void mono_assembly_close_finish (MonoAssembly *assembly) MONO_INTERNAL;
 
+void mono_assembly_prefetch_references (MonoAssembly *assembly) MONO_INTERNAL;
+
+const char *mono_register_bundled_assemblies_from_file (const char *path) MONO_INTERNAL;
+
 
 gboolean mono_public_tokens_are_equal (const unsigned char *pubt1, const unsigned char *pubt2) MONO_INTERNAL;
 
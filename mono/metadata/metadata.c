@@ -835,11 +835,35 @@ mono_metadata_compute_table_bases (MonoImage *meta)
 			continue;
 
 		table->row_size = mono_metadata_compute_size (meta, i, &table->size_bitfield);
+		mono_metadata_compute_column_offsets (table);
 		table->base = base;
 		base += table->rows * table->row_size;
 	}
 }
 
+/*
+ * mono_metadata_compute_column_offsets:
+ * @table: table whose size_bitfield has already been computed
+ *
+ * Fills in the column_offsets array of @table from its size_bitfield, so
+ * mono_metadata_decode_row_col () can address a column directly.
+ * This is an internal function used by the image loader code.
+ */
+void
+mono_metadata_compute_column_offsets (MonoTableInfo *table)
+{
+	guint32 bitfield = table->size_bitfield;
+	int i, count = mono_metadata_table_count (bitfield);
+	int offset = 0;
+
+	g_assert (count <= MONO_TABLE_MAX_COLUMNS);
+
+	for (i = 0; i < count; i++) {
+		table->column_offsets [i] = offset;
+		offset += mono_metadata_table_size (bitfield, i);
+	}
+}
+
 /**
  * mono_metadata_locate:
  * @meta: metadata context
@@ -995,20 +1019,13 @@ guint32
 mono_metadata_decode_row_col (const MonoTableInfo *t, int idx, guint col)
 {
 	guint32 bitfield = t->size_bitfield;
-	int i;
 	register const char *data; 
-	register int n;
 	
 	g_assert (idx < t->rows);
 	g_assert (col < mono_metadata_table_count (bitfield));
-	data = t->base + idx * t->row_size;
+	data = t->base + idx * t->row_size + t->column_offsets [col];
 
-	n = mono_metadata_table_size (bitfield, 0);
-	for (i = 0; i < col; ++i) {
-		data += n;
-		n = mono_metadata_table_size (bitfield, i + 1);
-	}
-	switch (n) {
+	switch (mono_metadata_table_size (bitfield, col)) {
 	case 1:
 		return *data;
 	case 2:
@@ -3826,24 +3843,46 @@ typedef_locator (const void *a, const void *b)
 	return 0;
 }
 
-static int
-table_locator (const void *a, const void *b)
+/*
+ * table_locator_search:
+ *
+ *   Binary search the table LOC->t, which must be sorted on column
+ * LOC->col_idx, for the first row whose column equals LOC->idx. On success
+ * the 0-based row is stored in LOC->result and TRUE is returned.
+ * The column is read in place instead of going through a bsearch ()
+ * callback, and since we return the lowest matching row callers don't need
+ * to walk backwards to the start of a run of equal keys.
+ */
+static inline guint32
+locator_read_key (const char *data, int size)
 {
-	locator_t *loc = (locator_t *) a;
-	const char *bb = (const char *) b;
-	guint32 table_index = (bb - loc->t->base) / loc->t->row_size;
-	guint32 col;
-	
-	col = mono_metadata_decode_row_col (loc->t, table_index, loc->col_idx);
+	/* Sorted key columns are always table or coded indexes */
+	return size == 2 ? read16 (data) : read32 (data);
+}
 
-	if (loc->idx == col) {
-		loc->result = table_index;
-		return 0;
+static gboolean
+table_locator_search (locator_t *loc)
+{
+	const MonoTableInfo *t = loc->t;
+	const char *data = t->base + t->column_offsets [loc->col_idx];
+	int size = mono_metadata_table_size (t->size_bitfield, loc->col_idx);
+	guint32 row_size = t->row_size;
+	guint32 idx = loc->idx;
+	guint32 low = 0, high = t->rows, mid;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (locator_read_key (data + mid * row_size, size) < idx)
+			low = mid + 1;
+		else
+			high = mid;
 	}
-	if (loc->idx < col)
-		return -1;
-	else 
-		return 1;
+
+	if (low >= t->rows || locator_read_key (data + low * row_size, size) != idx)
+		return FALSE;
+
+	loc->result = low;
+	return TRUE;
 }
 
 static int
@@ -3987,19 +4026,10 @@ mono_metadata_interfaces_from_typedef_full (MonoImage *meta, guint32 index, Mono
 	loc.col_idx = MONO_INTERFACEIMPL_CLASS;
 	loc.t = tdef;
 
-	if (!bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator))
+	if (!table_locator_search (&loc))
 		return TRUE;
 
 	start = loc.result;
-	/*
-	 * We may end up in the middle of the rows... 
-	 */
-	while (start > 0) {
-		if (loc.idx == mono_metadata_decode_row_col (tdef, start - 1, MONO_INTERFACEIMPL_CLASS))
-			start--;
-		else
-			break;
-	}
 	pos = start;
 	while (pos < tdef->rows) {
 		mono_metadata_decode_row (tdef, pos, cols, MONO_INTERFACEIMPL_SIZE);
@@ -4083,7 +4113,7 @@ mono_metadata_nested_in_typedef (MonoImage *meta, guint32 index)
 	loc.col_idx = MONO_NESTED_CLASS_NESTED;
 	loc.t = tdef;
 
-	if (!bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator))
+	if (!table_locator_search (&loc))
 		return 0;
 
 	/* loc_result is 0..1, needs to be mapped to table index (that is +1) */
@@ -4147,7 +4177,7 @@ mono_metadata_packing_from_typedef (MonoImage *meta, guint32 index, guint32 *pac
 	loc.col_idx = MONO_CLASS_LAYOUT_PARENT;
 	loc.t = tdef;
 
-	if (!bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator))
+	if (!table_locator_search (&loc))
 		return 0;
 
 	mono_metadata_decode_row (tdef, loc.result, cols, MONO_CLASS_LAYOUT_SIZE);
@@ -4184,13 +4214,9 @@ mono_metadata_custom_attrs_from_index (MonoImage *meta, guint32 index)
 
 	/* FIXME: Index translation */
 
-	if (!bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator))
+	if (!table_locator_search (&loc))
 		return 0;
 
-	/* Find the first entry by searching backwards */
-	while ((loc.result > 0) && (mono_metadata_decode_row_col (tdef, loc.result - 1, MONO_CUSTOM_ATTR_PARENT) == index))
-		loc.result --;
-
 	/* loc_result is 0..1, needs to be mapped to table index (that is +1) */
 	return loc.result + 1;
 }
@@ -4931,7 +4957,7 @@ mono_metadata_field_info_full (MonoImage *meta, guint32 index, guint32 *offset,
 		loc.col_idx = MONO_FIELD_LAYOUT_FIELD;
 		loc.t = tdef;
 
-		if (tdef->base && bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator)) {
+		if (tdef->base && table_locator_search (&loc)) {
 			*offset = mono_metadata_decode_row_col (tdef, loc.result, MONO_FIELD_LAYOUT_OFFSET);
 		} else {
 			*offset = (guint32)-1;
@@ -4943,7 +4969,7 @@ mono_metadata_field_info_full (MonoImage *meta, guint32 index, guint32 *offset,
 		loc.col_idx = MONO_FIELD_RVA_FIELD;
 		loc.t = tdef;
 		
-		if (tdef->base && bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator)) {
+		if (tdef->base && table_locator_search (&loc)) {
 			/*
 			 * LAMESPEC: There is no signature, no nothing, just the raw data.
 			 */
@@ -5004,7 +5030,7 @@ mono_metadata_get_constant_index (MonoImage *meta, guint32 token, guint32 hint)
 	if ((hint > 0) && (hint < tdef->rows) && (mono_metadata_decode_row_col (tdef, hint - 1, MONO_CONSTANT_PARENT) == index))
 		return hint;
 
-	if (tdef->base && bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator)) {
+	if (tdef->base && table_locator_search (&loc)) {
 		return loc.result + 1;
 	}
 	return 0;
@@ -5035,7 +5061,7 @@ mono_metadata_events_from_typedef (MonoImage *meta, guint32 index, guint *end_id
 	loc.col_idx = MONO_EVENT_MAP_PARENT;
 	loc.idx = index + 1;
 
-	if (!bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator))
+	if (!table_locator_search (&loc))
 		return 0;
 	
 	start = mono_metadata_decode_row_col (tdef, loc.result, MONO_EVENT_MAP_EVENTLIST);
@@ -5077,19 +5103,10 @@ mono_metadata_methods_from_event   (MonoImage *meta, guint32 index, guint *end_i
 	loc.col_idx = MONO_METHOD_SEMA_ASSOCIATION;
 	loc.idx = ((index + 1) << MONO_HAS_SEMANTICS_BITS) | MONO_HAS_SEMANTICS_EVENT; /* Method association coded index */
 
-	if (!bsearch (&loc, msemt->base, msemt->rows, msemt->row_size, table_locator))
+	if (!table_locator_search (&loc))
 		return 0;
 
 	start = loc.result;
-	/*
-	 * We may end up in the middle of the rows... 
-	 */
-	while (start > 0) {
-		if (loc.idx == mono_metadata_decode_row_col (msemt, start - 1, MONO_METHOD_SEMA_ASSOCIATION))
-			start--;
-		else
-			break;
-	}
 	end = start + 1;
 	while (end < msemt->rows) {
 		mono_metadata_decode_row (msemt, end, cols, MONO_METHOD_SEMA_SIZE);
@@ -5126,7 +5143,7 @@ mono_metadata_properties_from_typedef (MonoImage *meta, guint32 index, guint *en
 	loc.col_idx = MONO_PROPERTY_MAP_PARENT;
 	loc.idx = index + 1;
 
-	if (!bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator))
+	if (!table_locator_search (&loc))
 		return 0;
 	
 	start = mono_metadata_decode_row_col (tdef, loc.result, MONO_PROPERTY_MAP_PROPERTY_LIST);
@@ -5168,19 +5185,10 @@ mono_metadata_methods_from_property   (MonoImage *meta, guint32 index, guint *en
 	loc.col_idx = MONO_METHOD_SEMA_ASSOCIATION;
 	loc.idx = ((index + 1) << MONO_HAS_SEMANTICS_BITS) | MONO_HAS_SEMANTICS_PROPERTY; /* Method association coded index */
 
-	if (!bsearch (&loc, msemt->base, msemt->rows, msemt->row_size, table_locator))
+	if (!table_locator_search (&loc))
 		return 0;
 
 	start = loc.result;
-	/*
-	 * We may end up in the middle of the rows... 
-	 */
-	while (start > 0) {
-		if (loc.idx == mono_metadata_decode_row_col (msemt, start - 1, MONO_METHOD_SEMA_ASSOCIATION))
-			start--;
-		else
-			break;
-	}
 	end = start + 1;
 	while (end < msemt->rows) {
 		mono_metadata_decode_row (msemt, end, cols, MONO_METHOD_SEMA_SIZE);
@@ -5207,7 +5215,7 @@ mono_metadata_implmap_from_method (MonoImage *meta, guint32 method_idx)
 	loc.col_idx = MONO_IMPLMAP_MEMBER;
 	loc.idx = ((method_idx + 1) << MONO_MEMBERFORWD_BITS) | MONO_MEMBERFORWD_METHODDEF;
 
-	if (!bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator))
+	if (!table_locator_search (&loc))
 		return 0;
 
 	return loc.result + 1;
@@ -5591,7 +5599,7 @@ mono_metadata_get_marshal_info (MonoImage *meta, guint32 idx, gboolean is_field)
 
 	/* FIXME: Index translation */
 
-	if (!bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator))
+	if (!table_locator_search (&loc))
 		return NULL;
 
 	return mono_metadata_blob_heap (meta, mono_metadata_decode_row_col (tdef, loc.result, MONO_FIELD_MARSHAL_NATIVE_TYPE));
@@ -5644,20 +5652,11 @@ mono_class_get_overrides_full (MonoImage *image, guint32 type_token, MonoMethod
 	loc.col_idx = MONO_METHODIMPL_CLASS;
 	loc.idx = mono_metadata_token_index (type_token);
 
-	if (!bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator))
+	if (!table_locator_search (&loc))
 		return TRUE;
 
 	start = loc.result;
 	end = start + 1;
-	/*
-	 * We may end up in the middle of the rows... 
-	 */
-	while (start > 0) {
-		if (loc.idx == mono_metadata_decode_row_col (tdef, start - 1, MONO_METHODIMPL_CLASS))
-			start--;
-		else
-			break;
-	}
 	while (end < tdef->rows) {
 		if (loc.idx == mono_metadata_decode_row_col (tdef, end, MONO_METHODIMPL_CLASS))
 			end++;
@@ -5784,13 +5783,9 @@ mono_metadata_get_generic_param_row (MonoImage *image, guint32 token, guint32 *o
 	loc.col_idx = MONO_GENERICPARAM_OWNER;
 	loc.t = tdef;
 
-	if (!bsearch (&loc, tdef->base, tdef->rows, tdef->row_size, table_locator))
+	if (!table_locator_search (&loc))
 		return 0;
 
-	/* Find the first entry by searching backwards */
-	while ((loc.result > 0) && (mono_metadata_decode_row_col (tdef, loc.result - 1, MONO_GENERICPARAM_OWNER) == loc.idx))
-		loc.result --;
-
 	return loc.result + 1;
 }
 
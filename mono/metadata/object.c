@@ -40,6 +40,7 @@
 #include "mono/metadata/mono-debug-debugger.h"
 #include <mono/metadata/gc-internal.h>
 #include <mono/metadata/verify-internals.h>
+#include <mono/metadata/layout-cache.h>
 #include <mono/utils/strenc.h>
 #include <mono/utils/mono-counters.h>
 #include <mono/utils/mono-error-internals.h>
@@ -993,7 +994,9 @@ mono_class_compute_gc_descriptor (MonoClass *class)
 		/*static int count = 0;
 		if (count++ > 58)
 			return;*/
-		bitmap = compute_class_bitmap (class, default_bitmap, sizeof (default_bitmap) * 8, 0, &max_set, FALSE);
+		bitmap = mono_layout_cache_get_gc_bitmap (class, default_bitmap, sizeof (default_bitmap) * 8, &max_set);
+		if (!bitmap)
+			bitmap = compute_class_bitmap (class, default_bitmap, sizeof (default_bitmap) * 8, 0, &max_set, FALSE);
 		class->gc_descr = (gpointer)mono_gc_make_descr_for_object (bitmap, max_set + 1, class->instance_size);
 		/*
 		if (class->gc_descr == GC_NO_DESCRIPTOR)
@@ -1786,6 +1789,25 @@ mono_class_vtable (MonoDomain *domain, MonoClass *class)
 	return mono_class_vtable_full (domain, class, FALSE);
 }
 
+/*
+ * lookup_runtime_vtable:
+ *
+ *   Return the vtable of CLASS in DOMAIN if it has already been created, NULL otherwise.
+ *
+ * LOCKING: None. class->runtime_info and its slots are published with a barrier after
+ * the vtable is fully constructed, see mono_class_create_runtime_vtable (). The slot is
+ * read only once, since domain unloading can clear it concurrently.
+ */
+static inline MonoVTable*
+lookup_runtime_vtable (MonoDomain *domain, MonoClass *class)
+{
+	MonoClassRuntimeInfo *runtime_info = class->runtime_info;
+
+	if (runtime_info && runtime_info->max_domain >= domain->domain_id)
+		return runtime_info->domain_vtables [domain->domain_id];
+	return NULL;
+}
+
 /**
  * mono_class_vtable_full:
  * @domain: the application domain
@@ -1798,7 +1820,7 @@ mono_class_vtable (MonoDomain *domain, MonoClass *class)
 MonoVTable *
 mono_class_vtable_full (MonoDomain *domain, MonoClass *class, gboolean raise_on_error)
 {
-	MonoClassRuntimeInfo *runtime_info;
+	MonoVTable *vt;
 
 	g_assert (class);
 
@@ -1809,9 +1831,9 @@ mono_class_vtable_full (MonoDomain *domain, MonoClass *class, gboolean raise_on_
 	}
 
 	/* this check can be inlined in jitted code, too */
-	runtime_info = class->runtime_info;
-	if (runtime_info && runtime_info->max_domain >= domain->domain_id && runtime_info->domain_vtables [domain->domain_id])
-		return runtime_info->domain_vtables [domain->domain_id];
+	vt = lookup_runtime_vtable (domain, class);
+	if (vt)
+		return vt;
 	return mono_class_create_runtime_vtable (domain, class, raise_on_error);
 }
 
@@ -1826,14 +1848,9 @@ mono_class_vtable_full (MonoDomain *domain, MonoClass *class, gboolean raise_on_
 MonoVTable *
 mono_class_try_get_vtable (MonoDomain *domain, MonoClass *class)
 {
-	MonoClassRuntimeInfo *runtime_info;
-
 	g_assert (class);
 
-	runtime_info = class->runtime_info;
-	if (runtime_info && runtime_info->max_domain >= domain->domain_id && runtime_info->domain_vtables [domain->domain_id])
-		return runtime_info->domain_vtables [domain->domain_id];
-	return NULL;
+	return lookup_runtime_vtable (domain, class);
 }
 
 static MonoVTable *
@@ -1853,11 +1870,11 @@ mono_class_create_runtime_vtable (MonoDomain *domain, MonoClass *class, gboolean
 
 	mono_loader_lock (); /*FIXME mono_class_init acquires it*/
 	mono_domain_lock (domain);
-	runtime_info = class->runtime_info;
-	if (runtime_info && runtime_info->max_domain >= domain->domain_id && runtime_info->domain_vtables [domain->domain_id]) {
+	vt = lookup_runtime_vtable (domain, class);
+	if (vt) {
 		mono_domain_unlock (domain);
 		mono_loader_unlock ();
-		return runtime_info->domain_vtables [domain->domain_id];
+		return vt;
 	}
 	if (!class->inited || class->exception_type) {
 		if (!mono_class_init (class) || class->exception_type) {
@@ -2167,6 +2184,8 @@ mono_class_create_runtime_vtable (MonoDomain *domain, MonoClass *class, gboolean
 			MONO_GC_REGISTER_ROOT_IF_MOVING(vt->type);
 	}
 
+	mono_layout_cache_add_class (class);
+
 	mono_domain_unlock (domain);
 	mono_loader_unlock ();
 
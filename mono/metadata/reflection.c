@@ -4053,6 +4053,7 @@ build_compressed_metadata (MonoDynamicImage *assembly)
 		ntables ++;
 		meta->tables [i].row_size = mono_metadata_compute_size (
 			meta, i, &meta->tables [i].size_bitfield);
+		mono_metadata_compute_column_offsets (&meta->tables [i]);
 		heapt_size += meta->tables [i].row_size * meta->tables [i].rows;
 	}
 	heapt_size += 24; /* #~ header size */
@@ -8494,9 +8495,194 @@ mono_custom_attrs_data_construct (MonoCustomAttrInfo *cinfo)
 	return result;
 }
 
+/*
+ * Cache of the decoded custom attributes of a non dynamic image.
+ *
+ * BITS has one bit per hash bucket of the Parent column of the CustomAttribute
+ * table, so most metadata objects without attributes are rejected with a single
+ * memory read. The others are looked up in an open addressing table keyed by the
+ * coded parent index. A slot is claimed by a CAS on its key and filled by a CAS on
+ * its info, and neither changes after that, so lookups take no lock.
+ *
+ * The table has room for at least twice the number of distinct parents. Objects
+ * found to have no attributes are recorded as NO_CATTRS until the negative entries
+ * would fill half of the room left by the positive ones, so the table never gets
+ * more than 3/4 full and every parent can always be inserted.
+ *
+ * There is no filter of the attribute types of each parent: once the info of an
+ * object is cached, mono_custom_attrs_has_attr () only does a
+ * mono_class_has_parent () check per attribute, which is as cheap as probing such
+ * a filter, and the filter would need to load every attribute class and its
+ * parents up front to handle derived attribute types.
+ */
+typedef struct _MonoCustomAttrCache {
+	guint32 filter_mask;
+	guint32 slot_mask;
+	gint32 num_negative;
+	gint32 max_negative;
+	guint32 *keys;
+	MonoCustomAttrInfo **infos;
+	guint8 bits [MONO_ZERO_LEN_ARRAY];
+} MonoCustomAttrCache;
+
+static int no_cattrs_marker;
+#define NO_CATTRS ((MonoCustomAttrInfo*)&no_cattrs_marker)
+
+static inline guint32
+custom_attr_cache_hash (guint32 idx)
+{
+	guint32 h = idx * 2654435761U;
+
+	return h ^ (h >> 16);
+}
+
+static MonoCustomAttrCache*
+custom_attr_cache_create (MonoImage *image)
+{
+	MonoTableInfo *ca = &image->tables [MONO_TABLE_CUSTOMATTRIBUTE];
+	MonoCustomAttrCache *cache;
+	guint32 i, h, parent, prev = 0, nparents = 0, nbits = 64, nslots = 16;
+
+	/* About 8 bits per row keeps false positives low */
+	while (nbits < ca->rows * 8)
+		nbits <<= 1;
+
+	cache = g_malloc0 (sizeof (MonoCustomAttrCache) + nbits / 8);
+	cache->filter_mask = nbits - 1;
+	/* The table is sorted on the Parent column */
+	for (i = 0; i < ca->rows; ++i) {
+		parent = mono_metadata_decode_row_col (ca, i, MONO_CUSTOM_ATTR_PARENT);
+		h = custom_attr_cache_hash (parent) & cache->filter_mask;
+		cache->bits [h >> 3] |= 1 << (h & 7);
+		if (!i || parent != prev)
+			nparents ++;
+		prev = parent;
+	}
+
+	while (nslots < nparents * 2)
+		nslots <<= 1;
+	cache->slot_mask = nslots - 1;
+	cache->max_negative = (nslots - nparents) / 2;
+	cache->keys = g_new0 (guint32, nslots);
+	cache->infos = g_new0 (MonoCustomAttrInfo*, nslots);
+	return cache;
+}
+
+/*
+ * custom_attr_cache_get:
+ *
+ *   Return the cache of the non dynamic IMAGE, creating it if needed.
+ *
+ * LOCKING: None. The cache is published with a CAS, threads racing to create it
+ * just throw away their copy.
+ */
+static MonoCustomAttrCache*
+custom_attr_cache_get (MonoImage *image)
+{
+	MonoCustomAttrCache *cache = image->cattr_cache;
+
+	if (!cache) {
+		cache = custom_attr_cache_create (image);
+		if (InterlockedCompareExchangePointer ((gpointer*)&image->cattr_cache, cache, NULL) != NULL) {
+			g_free (cache->keys);
+			g_free (cache->infos);
+			g_free (cache);
+			cache = image->cattr_cache;
+		}
+	}
+	return cache;
+}
+
+static inline gboolean
+custom_attr_cache_may_exist (MonoCustomAttrCache *cache, guint32 idx)
+{
+	guint32 h = custom_attr_cache_hash (idx) & cache->filter_mask;
+
+	return (cache->bits [h >> 3] & (1 << (h & 7))) != 0;
+}
+
+/*
+ * custom_attr_cache_lookup:
+ *
+ *   Return the info cached for IDX, NO_CATTRS if it has no attributes, or NULL if
+ * nothing is cached for it yet.
+ */
+static MonoCustomAttrInfo*
+custom_attr_cache_lookup (MonoCustomAttrCache *cache, guint32 idx)
+{
+	guint32 h = custom_attr_cache_hash (idx) & cache->slot_mask;
+	guint32 key;
+
+	while ((key = cache->keys [h])) {
+		if (key == idx)
+			return cache->infos [h];
+		h = (h + 1) & cache->slot_mask;
+	}
+	return NULL;
+}
+
+/*
+ * custom_attr_cache_insert:
+ *
+ *   Record AINFO, or NO_CATTRS, as the info of IDX. Return the info which ended up
+ * in the cache, which is a different one if another thread got there first.
+ */
+static MonoCustomAttrInfo*
+custom_attr_cache_insert (MonoCustomAttrCache *cache, guint32 idx, MonoCustomAttrInfo *ainfo)
+{
+	guint32 h = custom_attr_cache_hash (idx) & cache->slot_mask;
+	MonoCustomAttrInfo *prev;
+	guint32 key;
+
+	/* Keep room for the positive entries, see MonoCustomAttrCache */
+	if (ainfo == NO_CATTRS && InterlockedIncrement (&cache->num_negative) > cache->max_negative)
+		return ainfo;
+
+	while (TRUE) {
+		key = cache->keys [h];
+		if (!key) {
+			key = InterlockedCompareExchange ((gint32*)&cache->keys [h], idx, 0);
+			if (!key)
+				key = idx;
+		}
+		if (key == idx)
+			break;
+		h = (h + 1) & cache->slot_mask;
+	}
+
+	prev = InterlockedCompareExchangePointer ((gpointer*)&cache->infos [h], ainfo, NULL);
+	return prev ? prev : ainfo;
+}
+
+/*
+ * mono_custom_attrs_free_image_cache:
+ *
+ *   Free the custom attribute cache of IMAGE, when it is closed.
+ */
+void
+mono_custom_attrs_free_image_cache (MonoImage *image)
+{
+	MonoCustomAttrCache *cache = image->cattr_cache;
+	guint32 i;
+
+	if (!cache)
+		return;
+	for (i = 0; i <= cache->slot_mask; ++i) {
+		if (cache->infos [i] != NO_CATTRS)
+			g_free (cache->infos [i]);
+	}
+	g_free (cache->keys);
+	g_free (cache->infos);
+	g_free (cache);
+	image->cattr_cache = NULL;
+}
+
 /**
  * mono_custom_attrs_from_index:
  *
+ * The result of non dynamic images is cached in the image and has its
+ * cached flag set, so mono_custom_attrs_free () leaves it alone.
+ *
  * Returns: NULL if no attributes are found or if a loading error occurs.
  */
 MonoCustomAttrInfo*
@@ -8506,24 +8692,41 @@ mono_custom_attrs_from_index (MonoImage *image, guint32 idx)
 	guint32 cols [MONO_CUSTOM_ATTR_SIZE];
 	MonoTableInfo *ca;
 	MonoCustomAttrInfo *ainfo;
+	MonoCustomAttrCache *cache = NULL;
 	GList *tmp, *list = NULL;
 	const char *data;
 
 	ca = &image->tables [MONO_TABLE_CUSTOMATTRIBUTE];
 
-	i = mono_metadata_custom_attrs_from_index (image, idx);
-	if (!i)
+	if (!ca->rows)
 		return NULL;
-	i --;
-	while (i < ca->rows) {
-		if (mono_metadata_decode_row_col (ca, i, MONO_CUSTOM_ATTR_PARENT) != idx)
-			break;
-		list = g_list_prepend (list, GUINT_TO_POINTER (i));
-		++i;
+
+	/* A zero key marks the free slots of the cache */
+	if (!image->dynamic && idx) {
+		cache = custom_attr_cache_get (image);
+		if (!custom_attr_cache_may_exist (cache, idx))
+			return NULL;
+		ainfo = custom_attr_cache_lookup (cache, idx);
+		if (ainfo)
+			return ainfo == NO_CATTRS ? NULL : ainfo;
+	}
+
+	i = mono_metadata_custom_attrs_from_index (image, idx);
+	if (i) {
+		i --;
+		while (i < ca->rows) {
+			if (mono_metadata_decode_row_col (ca, i, MONO_CUSTOM_ATTR_PARENT) != idx)
+				break;
+			list = g_list_prepend (list, GUINT_TO_POINTER (i));
+			++i;
+		}
 	}
 	len = g_list_length (list);
-	if (!len)
+	if (!len) {
+		if (cache)
+			custom_attr_cache_insert (cache, idx, NO_CATTRS);
 		return NULL;
+	}
 	ainfo = g_malloc0 (MONO_SIZEOF_CUSTOM_ATTR_INFO + sizeof (MonoCustomAttrEntry) * len);
 	ainfo->num_attrs = len;
 	ainfo->image = image;
@@ -8562,6 +8765,16 @@ mono_custom_attrs_from_index (MonoImage *image, guint32 idx)
 	}
 	g_list_free (list);
 
+	if (cache) {
+		MonoCustomAttrInfo *cached;
+
+		ainfo->cached = TRUE;
+		cached = custom_attr_cache_insert (cache, idx, ainfo);
+		if (cached != ainfo)
+			g_free (ainfo);
+		ainfo = cached;
+	}
+
 	return ainfo;
 }
 
@@ -33,6 +33,7 @@
 #include <netinet/tcp.h>
 #include <netdb.h>
 #include <arpa/inet.h>
+#include <fcntl.h>
 #endif
 
 #include <mono/metadata/object.h>
@@ -51,6 +52,8 @@
 #include <mono/metadata/domain-internals.h>
 #include <mono/utils/mono-threads.h>
 #include <mono/utils/mono-memory-model.h>
+#include <mono/utils/mono-mmap.h>
+#include <mono/utils/mono-time.h>
 
 #include <time.h>
 #ifdef HAVE_SYS_TIME_H
@@ -777,6 +780,8 @@ gpointer ves_icall_System_Net_Sockets_Socket_Socket_internal(MonoObject *this, g
 	return(GUINT_TO_POINTER (sock));
 }
 
+static void zerocopy_socket_closed (SOCKET sock);
+
 /* FIXME: the SOCKET parameter (here and in other functions in this
  * file) is really an IntPtr which needs to be converted to a guint32.
  */
@@ -792,6 +797,7 @@ void ves_icall_System_Net_Sockets_Socket_Close_internal(SOCKET sock,
 	/* Clear any pending work item from this socket if the underlying
 	 * polling system does not notify when the socket is closed */
 	mono_thread_pool_remove_socket (GPOINTER_TO_INT (sock));
+	zerocopy_socket_closed (sock);
 	closesocket(sock);
 }
 
@@ -1630,6 +1636,494 @@ gint32 ves_icall_System_Net_Sockets_Socket_Send_array_internal(SOCKET sock, Mono
 	return(sent);
 }
 
+/*
+ * Socket buffer pool.
+ *
+ *   Segments are carved out of slabs allocated outside of the GC heap, so they never
+ * move and the kernel can keep referencing them after a send returns. This is what
+ * makes MSG_ZEROCOPY usable: large sends from segments on blocking sockets are done
+ * without copying, and the segments stay busy until the kernel reports the send as
+ * completed on the error queue of the socket. Segments are also busy while a send or
+ * a receive uses them. A segment freed by managed code in the meantime only goes back
+ * to its free list once it is no longer busy.
+ */
+
+#define SEGMENT_MIN_SIZE 4096
+#define SEGMENT_NUM_CLASSES 5
+#define SEGMENT_SLAB_SIZE (1024 * 1024)
+/* Sends smaller than this are cheaper to copy than to pin */
+#define ZEROCOPY_MIN_SIZE (64 * 1024)
+/* How long the segments of the pending sends of a closed socket are kept busy, in 100ns ticks */
+#define ZEROCOPY_CLOSE_GRACE (60 * (gint64)10000000)
+
+typedef struct _SocketSegment SocketSegment;
+
+struct _SocketSegment {
+	guint8 *data;
+	guint32 size;
+	/* Incremented each time the segment is allocated, so stale handles are rejected */
+	guint32 generation;
+	/* Set from the allocation of the segment until managed code frees it */
+	gboolean allocated;
+	/* Number of sends and receives using the segment, including zero copy sends not completed yet */
+	int busy;
+	/* Set when managed code freed the segment while it was busy */
+	gboolean free_pending;
+	SocketSegment *next_free;
+};
+
+typedef struct {
+	guint32 id;
+	/* Only used for the sends of closed sockets */
+	gint64 release_time;
+	int num_segments;
+	SocketSegment *segments [MONO_ZERO_LEN_ARRAY];
+} ZeroCopySend;
+
+typedef struct {
+	/* The ZeroCopySend entries which are not completed yet, in the order of their ids */
+	GQueue sends;
+	/* Number of threads sending on the socket, its completions can't be reaped meanwhile */
+	int sending;
+} ZeroCopySocket;
+
+/* This is the layout of System.Net.Sockets.Socket/SegmentBuf */
+typedef struct {
+	SocketSegment *segment;
+	guint32 generation;
+	gint32 offset;
+	gint32 count;
+} MonoSegmentBuf;
+
+/* This protects the free lists and the zero copy state */
+#define mono_segments_lock() EnterCriticalSection (&segments_mutex)
+#define mono_segments_unlock() LeaveCriticalSection (&segments_mutex)
+static CRITICAL_SECTION segments_mutex;
+
+static SocketSegment *segment_free_lists [SEGMENT_NUM_CLASSES];
+/* Maps sockets to their ZeroCopySocket */
+static GHashTable *zerocopy_sockets;
+/* ZeroCopySend entries of closed sockets */
+static GSList *zerocopy_closed_sends;
+
+static int
+segment_class (gint32 size)
+{
+	int i;
+
+	for (i = 0; i < SEGMENT_NUM_CLASSES; ++i)
+		if (size <= (SEGMENT_MIN_SIZE << i))
+			return i;
+	return -1;
+}
+
+/* LOCKING: Assumes the segments lock is held */
+static gboolean
+add_segment_slab (int cls)
+{
+	guint32 size = SEGMENT_MIN_SIZE << cls;
+	int i, num = SEGMENT_SLAB_SIZE / size;
+	SocketSegment *segments;
+	guint8 *slab;
+
+	slab = mono_valloc (NULL, SEGMENT_SLAB_SIZE, MONO_MMAP_READ | MONO_MMAP_WRITE);
+	if (!slab)
+		return FALSE;
+
+	/* Slabs are never freed, so neither are the segment headers */
+	segments = g_new0 (SocketSegment, num);
+	for (i = 0; i < num; ++i) {
+		segments [i].data = slab + i * size;
+		segments [i].size = size;
+		segments [i].next_free = i + 1 < num ? &segments [i + 1] : segment_free_lists [cls];
+	}
+	segment_free_lists [cls] = &segments [0];
+	return TRUE;
+}
+
+/* LOCKING: Assumes the segments lock is held */
+static void
+segment_release (SocketSegment *seg)
+{
+	int cls = segment_class (seg->size);
+
+	seg->free_pending = FALSE;
+	seg->next_free = segment_free_lists [cls];
+	segment_free_lists [cls] = seg;
+}
+
+/* LOCKING: Assumes the segments lock is held */
+static void
+zerocopy_send_completed (ZeroCopySend *zsend)
+{
+	SocketSegment *seg;
+	int i;
+
+	for (i = 0; i < zsend->num_segments; ++i) {
+		seg = zsend->segments [i];
+		g_assert (seg->busy > 0);
+		if (--seg->busy == 0 && seg->free_pending)
+			segment_release (seg);
+	}
+	g_free (zsend);
+}
+
+/*
+ * zerocopy_reap:
+ *
+ *   Release the segments of the sends on SOCK the kernel is done with.
+ * LOCKING: Assumes the segments lock is held.
+ */
+static void
+zerocopy_reap (SOCKET sock, ZeroCopySocket *zsock)
+{
+	ZeroCopySend *zsend;
+	guint32 first, last;
+
+	if (zsock->sending)
+		return;
+
+#ifndef HOST_WIN32
+	while (!g_queue_is_empty (&zsock->sends) && wapi_zerocopy_completion (sock, &first, &last)) {
+		/* The kernel reports completions in order, and might merge consecutive ones */
+		while (zsock->sends.head && (zsend = zsock->sends.head->data) && (guint32)(zsend->id - first) <= (guint32)(last - first)) {
+			g_queue_pop_head (&zsock->sends);
+			zerocopy_send_completed (zsend);
+		}
+	}
+#endif
+}
+
+static gboolean
+zerocopy_reap_socket (gpointer key, gpointer value, gpointer user_data)
+{
+	ZeroCopySocket *zsock = value;
+
+	zerocopy_reap (GPOINTER_TO_UINT (key), zsock);
+	if (g_queue_is_empty (&zsock->sends) && !zsock->sending) {
+		g_free (zsock);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/* LOCKING: Assumes the segments lock is held */
+static void
+zerocopy_reap_all (void)
+{
+	gint64 now = mono_100ns_ticks ();
+	GSList *l, *next;
+
+	g_hash_table_foreach_remove (zerocopy_sockets, zerocopy_reap_socket, NULL);
+
+	for (l = zerocopy_closed_sends; l; l = next) {
+		ZeroCopySend *zsend = l->data;
+
+		next = l->next;
+		if (now >= zsend->release_time) {
+			zerocopy_closed_sends = g_slist_delete_link (zerocopy_closed_sends, l);
+			zerocopy_send_completed (zsend);
+		}
+	}
+}
+
+/*
+ * zerocopy_socket_closed:
+ *
+ *   Called before SOCK is closed. The kernel keeps transmitting the data of its
+ * pending sends after the close, but their completions can no longer be read,
+ * so the segments are released after a grace period instead.
+ */
+static void
+zerocopy_socket_closed (SOCKET sock)
+{
+	ZeroCopySocket *zsock;
+	ZeroCopySend *zsend;
+	gint64 release_time;
+
+	mono_segments_lock ();
+	zsock = g_hash_table_lookup (zerocopy_sockets, GUINT_TO_POINTER (sock));
+	if (zsock) {
+		zerocopy_reap (sock, zsock);
+		release_time = mono_100ns_ticks () + ZEROCOPY_CLOSE_GRACE;
+		while ((zsend = g_queue_pop_head (&zsock->sends))) {
+			zsend->release_time = release_time;
+			zerocopy_closed_sends = g_slist_prepend (zerocopy_closed_sends, zsend);
+		}
+		/* A thread still sending on the socket will find it gone and release its segments */
+		g_hash_table_remove (zerocopy_sockets, GUINT_TO_POINTER (sock));
+		g_free (zsock);
+	}
+	mono_segments_unlock ();
+}
+
+gpointer
+ves_icall_System_Net_Sockets_Socket_AllocSegment_internal (gint32 size, gpointer *data, gint32 *capacity, guint32 *generation)
+{
+	SocketSegment *seg;
+	int cls;
+
+	MONO_ARCH_SAVE_REGS;
+
+	*data = NULL;
+	*capacity = 0;
+	*generation = 0;
+
+	cls = size > 0 ? segment_class (size) : -1;
+	if (cls == -1)
+		return NULL;
+
+	mono_segments_lock ();
+	if (!segment_free_lists [cls] && zerocopy_closed_sends)
+		zerocopy_reap_all ();
+	if (!segment_free_lists [cls] && !add_segment_slab (cls)) {
+		mono_segments_unlock ();
+		return NULL;
+	}
+	seg = segment_free_lists [cls];
+	segment_free_lists [cls] = seg->next_free;
+	seg->next_free = NULL;
+	seg->allocated = TRUE;
+	seg->generation ++;
+	*generation = seg->generation;
+	mono_segments_unlock ();
+
+	*data = seg->data;
+	*capacity = seg->size;
+	return seg;
+}
+
+void
+ves_icall_System_Net_Sockets_Socket_FreeSegment_internal (gpointer segment)
+{
+	SocketSegment *seg = segment;
+
+	MONO_ARCH_SAVE_REGS;
+
+	mono_segments_lock ();
+	if (seg->allocated) {
+		seg->allocated = FALSE;
+		if (seg->busy)
+			zerocopy_reap_all ();
+		if (seg->busy)
+			seg->free_pending = TRUE;
+		else
+			segment_release (seg);
+	}
+	mono_segments_unlock ();
+}
+
+/* LOCKING: Assumes the segments lock is held */
+static void
+segment_bufs_release_locked (MonoSegmentBuf *bufs, int count)
+{
+	SocketSegment *seg;
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		seg = bufs [i].segment;
+		g_assert (seg->busy > 0);
+		if (--seg->busy == 0 && seg->free_pending)
+			segment_release (seg);
+	}
+}
+
+/*
+ * segment_bufs_acquire:
+ *
+ *   Convert the SegmentBuf array BUFFERS to WSABUFS, checking that every entry refers
+ * to a segment which is still allocated and lies inside it. The segments are marked
+ * busy, so a concurrent free doesn't hand them out again until segment_bufs_release ()
+ * is called. Return the total number of bytes, or -1 if an entry is invalid.
+ */
+static gint64
+segment_bufs_acquire (MonoArray *buffers, WSABUF *wsabufs)
+{
+	MonoSegmentBuf *bufs = mono_array_addr (buffers, MonoSegmentBuf, 0);
+	int i, count = mono_array_length (buffers);
+	SocketSegment *seg;
+	gint64 total = 0;
+
+	mono_segments_lock ();
+	for (i = 0; i < count; ++i) {
+		seg = bufs [i].segment;
+		if (!seg || !seg->allocated || seg->generation != bufs [i].generation ||
+		    bufs [i].offset < 0 || bufs [i].count < 0 ||
+		    (guint32)bufs [i].count > seg->size || (guint32)bufs [i].offset > seg->size - (guint32)bufs [i].count) {
+			segment_bufs_release_locked (bufs, i);
+			mono_segments_unlock ();
+			return -1;
+		}
+		seg->busy ++;
+		wsabufs [i].buf = (gpointer)(seg->data + bufs [i].offset);
+		wsabufs [i].len = bufs [i].count;
+		total += bufs [i].count;
+	}
+	mono_segments_unlock ();
+	return total;
+}
+
+static void
+segment_bufs_release (MonoArray *buffers)
+{
+	mono_segments_lock ();
+	segment_bufs_release_locked (mono_array_addr (buffers, MonoSegmentBuf, 0), mono_array_length (buffers));
+	mono_segments_unlock ();
+}
+
+#ifndef HOST_WIN32
+/*
+ * Zero copy sends are only done on blocking sockets: a pending completion makes the
+ * socket poll as failed, which is harmless for a blocking call, but would turn the
+ * next asynchronous operation on a non-blocking socket into a spurious error.
+ */
+static gboolean
+socket_is_blocking (SOCKET sock)
+{
+	int flags = fcntl (sock, F_GETFL, 0);
+
+	return flags != -1 && !(flags & O_NONBLOCK);
+}
+
+static int
+send_segments_zerocopy (SOCKET sock, MonoArray *buffers, WSABUF *wsabufs, guint32 *sent, guint32 flags)
+{
+	MonoSegmentBuf *bufs = mono_array_addr (buffers, MonoSegmentBuf, 0);
+	int i, ret, count = mono_array_length (buffers);
+	ZeroCopySocket *zsock;
+	ZeroCopySend *zsend;
+	gint64 id;
+
+	mono_segments_lock ();
+	zsock = g_hash_table_lookup (zerocopy_sockets, GUINT_TO_POINTER (sock));
+	if (!zsock) {
+		zsock = g_new0 (ZeroCopySocket, 1);
+		g_hash_table_insert (zerocopy_sockets, GUINT_TO_POINTER (sock), zsock);
+	}
+	zerocopy_reap (sock, zsock);
+	zsock->sending ++;
+	/* Keep the segments busy from before the kernel can reference them */
+	zsend = g_malloc0 (sizeof (ZeroCopySend) + count * sizeof (SocketSegment*));
+	zsend->num_segments = count;
+	for (i = 0; i < count; ++i) {
+		zsend->segments [i] = bufs [i].segment;
+		zsend->segments [i]->busy ++;
+	}
+	mono_segments_unlock ();
+
+	ret = wapi_send_zerocopy (sock, wsabufs, count, sent, flags, &id);
+
+	mono_segments_lock ();
+	zsock = g_hash_table_lookup (zerocopy_sockets, GUINT_TO_POINTER (sock));
+	if (zsock)
+		zsock->sending --;
+	if (id == -1) {
+		zerocopy_send_completed (zsend);
+	} else {
+		zsend->id = (guint32)id;
+		if (zsock) {
+			g_queue_push_tail (&zsock->sends, zsend);
+		} else {
+			/* The socket was closed while sending */
+			zsend->release_time = mono_100ns_ticks () + ZEROCOPY_CLOSE_GRACE;
+			zerocopy_closed_sends = g_slist_prepend (zerocopy_closed_sends, zsend);
+		}
+	}
+	mono_segments_unlock ();
+
+	return ret;
+}
+#endif
+
+gint32
+ves_icall_System_Net_Sockets_Socket_SendSegments_internal (SOCKET sock, MonoArray *buffers, gint32 flags, gint32 *error)
+{
+	WSABUF stack_wsabufs [16];
+	WSABUF *wsabufs;
+	int ret, count;
+	DWORD sent;
+	DWORD sendflags = 0;
+	gint64 total;
+
+	MONO_ARCH_SAVE_REGS;
+
+	*error = 0;
+
+	sendflags = convert_socketflags (flags);
+	if (sendflags == -1) {
+		*error = WSAEOPNOTSUPP;
+		return(0);
+	}
+
+	count = mono_array_length (buffers);
+	wsabufs = count <= G_N_ELEMENTS (stack_wsabufs) ? stack_wsabufs : g_new (WSABUF, count);
+
+	total = segment_bufs_acquire (buffers, wsabufs);
+	if (total == -1) {
+		ret = SOCKET_ERROR;
+		WSASetLastError (WSAEINVAL);
+	} else {
+#ifndef HOST_WIN32
+		if (total >= ZEROCOPY_MIN_SIZE && socket_is_blocking (sock))
+			ret = send_segments_zerocopy (sock, buffers, wsabufs, &sent, sendflags);
+		else
+#endif
+			ret = WSASend (sock, wsabufs, count, &sent, sendflags, NULL, NULL);
+		segment_bufs_release (buffers);
+	}
+
+	if (wsabufs != stack_wsabufs)
+		g_free (wsabufs);
+
+	if (ret == SOCKET_ERROR) {
+		*error = WSAGetLastError ();
+		return(0);
+	}
+
+	return(sent);
+}
+
+gint32
+ves_icall_System_Net_Sockets_Socket_ReceiveSegments_internal (SOCKET sock, MonoArray *buffers, gint32 flags, gint32 *error)
+{
+	WSABUF stack_wsabufs [16];
+	WSABUF *wsabufs;
+	int ret, count;
+	DWORD recv;
+	DWORD recvflags = 0;
+
+	MONO_ARCH_SAVE_REGS;
+
+	*error = 0;
+
+	recvflags = convert_socketflags (flags);
+	if (recvflags == -1) {
+		*error = WSAEOPNOTSUPP;
+		return(0);
+	}
+
+	count = mono_array_length (buffers);
+	wsabufs = count <= G_N_ELEMENTS (stack_wsabufs) ? stack_wsabufs : g_new (WSABUF, count);
+
+	if (segment_bufs_acquire (buffers, wsabufs) == -1) {
+		ret = SOCKET_ERROR;
+		WSASetLastError (WSAEINVAL);
+	} else {
+		ret = WSARecv (sock, wsabufs, count, &recv, &recvflags, NULL, NULL);
+		segment_bufs_release (buffers);
+	}
+
+	if (wsabufs != stack_wsabufs)
+		g_free (wsabufs);
+
+	if (ret == SOCKET_ERROR) {
+		*error = WSAGetLastError ();
+		return(0);
+	}
+
+	return(recv);
+}
+
 gint32 ves_icall_System_Net_Sockets_Socket_SendTo_internal(SOCKET sock, MonoArray *buffer, gint32 offset, gint32 count, gint32 flags, MonoObject *sockaddr, gint32 *error)
 {
 	int ret;
@@ -3276,6 +3770,9 @@ void mono_network_init(void)
 
 	LOGDEBUG (g_message("%s: Using socket library: %s", __func__, wsadata.szDescription));
 	LOGDEBUG (g_message("%s: Socket system status: %s", __func__, wsadata.szSystemStatus));
+
+	InitializeCriticalSection (&segments_mutex);
+	zerocopy_sockets = g_hash_table_new (NULL, NULL);
 }
 
 void mono_network_cleanup(void)
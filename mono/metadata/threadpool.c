@@ -93,7 +93,17 @@ typedef struct {
 	void (*shutdown) (gpointer event_data);
 } SocketIOData;
 
-static SocketIOData socket_io_data;
+/*
+ * Sockets are spread over several independent event loops, each one with its
+ * own wait thread, lock and state table, so a single epoll/kqueue thread does
+ * not become the bottleneck with many connections. A socket always maps to the
+ * same loop, see socket_io_data_for_fd ().
+ */
+#define MAX_SOCKET_IO_LOOPS 64
+#define CPUS_PER_SOCKET_IO_LOOP 4
+
+static SocketIOData socket_io_data [MAX_SOCKET_IO_LOOPS];
+static gint socket_io_nloops = 1;
 
 /* Keep in sync with the System.MonoAsyncCall class which provides GC tracking */
 typedef struct {
@@ -148,6 +158,7 @@ static void threadpool_kill_idle_threads (ThreadPool *tp);
 static gboolean threadpool_start_thread (ThreadPool *tp);
 static void monitor_thread (gpointer data);
 static void socket_io_cleanup (SocketIOData *data);
+static void socket_io_cleanup_all (void);
 static MonoObject *get_io_event (MonoMList **list, gint event);
 static int get_events_from_list (MonoMList *list);
 static int get_event_from_state (MonoSocketAsyncResult *state);
@@ -288,9 +299,16 @@ is_sdp_asyncreadhandler (MonoDomain *domain, MonoClass *klass)
 }
 
 
+static inline SocketIOData *
+socket_io_data_for_fd (int fd)
+{
+	return &socket_io_data [(guint) fd % socket_io_nloops];
+}
+
 #ifdef DISABLE_SOCKETS
 
 #define socket_io_cleanup(x)
+#define socket_io_cleanup_all()
 
 static int
 get_event_from_state (MonoSocketAsyncResult *state)
@@ -320,6 +338,15 @@ socket_io_cleanup (SocketIOData *data)
 	LeaveCriticalSection (&data->io_lock);
 }
 
+static void
+socket_io_cleanup_all (void)
+{
+	int i;
+
+	for (i = 0; i < socket_io_nloops; i++)
+		socket_io_cleanup (&socket_io_data [i]);
+}
+
 static int
 get_event_from_state (MonoSocketAsyncResult *state)
 {
@@ -432,22 +459,24 @@ get_io_event (MonoMList **list, gint event)
 void
 mono_thread_pool_remove_socket (int sock)
 {
+	SocketIOData *data;
 	MonoMList *list;
 	MonoSocketAsyncResult *state;
 	MonoObject *ares;
 
-	if (socket_io_data.inited == 0)
+	data = socket_io_data_for_fd (sock);
+	if (data->inited == 0)
 		return;
 
-	EnterCriticalSection (&socket_io_data.io_lock);
-	if (socket_io_data.sock_to_state == NULL) {
-		LeaveCriticalSection (&socket_io_data.io_lock);
+	EnterCriticalSection (&data->io_lock);
+	if (data->sock_to_state == NULL) {
+		LeaveCriticalSection (&data->io_lock);
 		return;
 	}
-	list = mono_g_hash_table_lookup (socket_io_data.sock_to_state, GINT_TO_POINTER (sock));
+	list = mono_g_hash_table_lookup (data->sock_to_state, GINT_TO_POINTER (sock));
 	if (list)
-		mono_g_hash_table_remove (socket_io_data.sock_to_state, GINT_TO_POINTER (sock));
-	LeaveCriticalSection (&socket_io_data.io_lock);
+		mono_g_hash_table_remove (data->sock_to_state, GINT_TO_POINTER (sock));
+	LeaveCriticalSection (&data->io_lock);
 	
 	while (list) {
 		state = (MonoSocketAsyncResult *) mono_mlist_get_data (list);
@@ -525,12 +554,14 @@ static void
 socket_io_add (MonoAsyncResult *ares, MonoSocketAsyncResult *state)
 {
 	MonoMList *list;
-	SocketIOData *data = &socket_io_data;
+	SocketIOData *data;
 	int fd;
 	gboolean is_new;
 	int ievt;
 
-	socket_io_init (&socket_io_data);
+	fd = GPOINTER_TO_INT (state->handle);
+	data = socket_io_data_for_fd (fd);
+	socket_io_init (data);
 	if (mono_runtime_is_shutting_down () || data->inited == 3 || data->sock_to_state == NULL)
 		return;
 	if (async_tp.pool_status == 2)
@@ -538,7 +569,6 @@ socket_io_add (MonoAsyncResult *ares, MonoSocketAsyncResult *state)
 
 	MONO_OBJECT_SETREF (state, ares, ares);
 
-	fd = GPOINTER_TO_INT (state->handle);
 	EnterCriticalSection (&data->io_lock);
 	if (data->sock_to_state == NULL) {
 		LeaveCriticalSection (&data->io_lock);
@@ -727,7 +757,11 @@ print_pool_info (ThreadPool *tp)
 		}
 		LeaveCriticalSection (&wsqs_lock);
 	} else {
-		g_print ("\tSockets: %d\n", mono_g_hash_table_size (socket_io_data.sock_to_state));
+		int i;
+		for (i = 0; i < socket_io_nloops; i++) {
+			if (socket_io_data [i].sock_to_state)
+				g_print ("\tSockets (loop %d): %d\n", i, mono_g_hash_table_size (socket_io_data [i].sock_to_state));
+		}
 	}
 	g_print ("-------------\n");
 }
@@ -808,6 +842,7 @@ mono_thread_pool_init ()
 	gint thread_count;
 	gint cpu_count = mono_cpu_count ();
 	int result;
+	int i;
 
 	if (tp_inited == 2)
 		return;
@@ -821,8 +856,15 @@ mono_thread_pool_init ()
 		}
 	}
 
-	MONO_GC_REGISTER_ROOT_FIXED (socket_io_data.sock_to_state);
-	InitializeCriticalSection (&socket_io_data.io_lock);
+	socket_io_nloops = (cpu_count + CPUS_PER_SOCKET_IO_LOOP - 1) / CPUS_PER_SOCKET_IO_LOOP;
+	if (g_getenv ("MONO_IO_EVENT_THREADS") != NULL)
+		socket_io_nloops = atoi (g_getenv ("MONO_IO_EVENT_THREADS"));
+	socket_io_nloops = CLAMP (socket_io_nloops, 1, MAX_SOCKET_IO_LOOPS);
+
+	for (i = 0; i < socket_io_nloops; i++) {
+		MONO_GC_REGISTER_ROOT_FIXED (socket_io_data [i].sock_to_state);
+		InitializeCriticalSection (&socket_io_data [i].io_lock);
+	}
 	if (g_getenv ("MONO_THREADS_PER_CPU") != NULL) {
 		threads_per_cpu = atoi (g_getenv ("MONO_THREADS_PER_CPU"));
 		if (threads_per_cpu < 1)
@@ -971,7 +1013,7 @@ void
 mono_thread_pool_cleanup (void)
 {
 	if (InterlockedExchange (&async_io_tp.pool_status, 2) == 1) {
-		socket_io_cleanup (&socket_io_data); /* Empty when DISABLE_SOCKETS is defined */
+		socket_io_cleanup_all (); /* Empty when DISABLE_SOCKETS is defined */
 		threadpool_kill_idle_threads (&async_io_tp);
 	}
 
@@ -1128,17 +1170,21 @@ mono_thread_pool_remove_domain_jobs (MonoDomain *domain, int timeout)
 	HANDLE sem_handle;
 	int result = TRUE;
 	guint32 start_time = 0;
+	int i;
 
 	g_assert (domain->state == MONO_APPDOMAIN_UNLOADING);
 
 	threadpool_clear_queue (&async_tp, domain);
 	threadpool_clear_queue (&async_io_tp, domain);
 
-	EnterCriticalSection (&socket_io_data.io_lock);
-	if (socket_io_data.sock_to_state)
-		mono_g_hash_table_foreach_remove (socket_io_data.sock_to_state, remove_sockstate_for_domain, domain);
+	for (i = 0; i < socket_io_nloops; i++) {
+		SocketIOData *data = &socket_io_data [i];
 
-	LeaveCriticalSection (&socket_io_data.io_lock);
+		EnterCriticalSection (&data->io_lock);
+		if (data->sock_to_state)
+			mono_g_hash_table_foreach_remove (data->sock_to_state, remove_sockstate_for_domain, domain);
+		LeaveCriticalSection (&data->io_lock);
+	}
 	
 	/*
 	 * There might be some threads out that could be about to execute stuff from the given domain.
@@ -61,6 +61,7 @@
 #include <mono/utils/mono-compiler.h>
 #include <mono/utils/mono-time.h>
 #include <mono/utils/mono-mmap.h>
+#include <mono/utils/mono-digest.h>
 
 #include "mini.h"
 #include "image-writer.h"
@@ -143,6 +144,8 @@ typedef struct MonoAotOptions {
 	gboolean autoreg;
 	char *mtriple;
 	char *llvm_path;
+	char *cache_dir;
+	GSList *instances_logs;
 } MonoAotOptions;
 
 typedef struct MonoAotStats {
@@ -5820,10 +5823,14 @@ mono_aot_parse_options (const char *aot_options, MonoAotOptions *opts)
 			opts->no_instances = TRUE;
 		} else if (str_begins_with (arg, "log-generics")) {
 			opts->log_generics = TRUE;
+		} else if (str_begins_with (arg, "instances-log=")) {
+			opts->instances_logs = g_slist_append (opts->instances_logs, g_strdup (arg + strlen ("instances-log=")));
 		} else if (str_begins_with (arg, "mtriple=")) {
 			opts->mtriple = g_strdup (arg + strlen ("mtriple="));
 		} else if (str_begins_with (arg, "llvm-path=")) {
 			opts->llvm_path = g_strdup (arg + strlen ("llvm-path="));
+		} else if (str_begins_with (arg, "cache-dir=")) {
+			opts->cache_dir = g_strdup (arg + strlen ("cache-dir="));
 		} else if (str_begins_with (arg, "readonly-value=")) {
 			add_readonly_value (opts, arg + strlen ("readonly-value="));
 		} else if (str_begins_with (arg, "info")) {
@@ -5853,10 +5860,12 @@ mono_aot_parse_options (const char *aot_options, MonoAotOptions *opts)
 			printf ("    autoreg\n");
 			printf ("    tool-prefix=\n");
 			printf ("    readonly-value=\n");
+			printf ("    cache-dir=\n");
 			printf ("    soft-debug\n");
 			printf ("    gc-maps\n");
 			printf ("    print-skipped\n");
 			printf ("    no-instances\n");
+			printf ("    instances-log=\n");
 			printf ("    stats\n");
 			printf ("    info\n");
 			printf ("    help/?\n");
@@ -7340,7 +7349,8 @@ emit_got_info (MonoAotCompile *acfg)
 	/* Encode info required to decode shared GOT entries */
 	buf_size = acfg->got_patches->len * 128;
 	p = buf = mono_mempool_alloc (acfg->mempool, buf_size);
-	got_info_offsets = mono_mempool_alloc (acfg->mempool, acfg->got_patches->len * sizeof (guint32));
+	/* Indexed by GOT slot, the slot of PLT entry 0 has no patch */
+	got_info_offsets = mono_mempool_alloc0 (acfg->mempool, acfg->got_offset * sizeof (guint32));
 	acfg->plt_got_info_offsets = mono_mempool_alloc (acfg->mempool, acfg->plt_offset * sizeof (guint32));
 	/* Unused */
 	if (acfg->plt_offset)
@@ -7356,10 +7366,16 @@ emit_got_info (MonoAotCompile *acfg)
 		encode_patch (acfg, ji, p, &p);
 		acfg->stats.got_slot_info_sizes [ji->type] += p - p2;
 		g_assert (p - buf <= buf_size);
-		got_info_offsets [i] = add_to_blob (acfg, buf, p - buf);
+		if (i >= first_plt_got_patch) {
+			/* The trampoline GOT entries might lie between the normal and the PLT slots */
+			int got_slot = acfg->plt_got_offset_base + (i - first_plt_got_patch) + 1;
 
-		if (i >= first_plt_got_patch)
-			acfg->plt_got_info_offsets [i - first_plt_got_patch + 1] = got_info_offsets [i];
+			g_assert (got_slot < acfg->got_offset);
+			acfg->plt_got_info_offsets [i - first_plt_got_patch + 1] = add_to_blob (acfg, buf, p - buf);
+			got_info_offsets [got_slot] = acfg->plt_got_info_offsets [i - first_plt_got_patch + 1];
+		} else {
+			got_info_offsets [i] = add_to_blob (acfg, buf, p - buf);
+		}
 		acfg->stats.got_info_size += p - buf;
 	}
 
@@ -7369,8 +7385,11 @@ emit_got_info (MonoAotCompile *acfg)
 	emit_alignment (acfg, 8);
 	emit_label (acfg, symbol);
 
-	/* No need to emit offsets for the got plt entries, the plt embeds them directly */
-	acfg->stats.offsets_size += emit_offset_table (acfg, first_plt_got_patch, 10, (gint32*)got_info_offsets);
+	/*
+	 * The PLT embeds the offsets of its entries too, but they are also needed here
+	 * so the runtime can resolve PLT entries without decoding the PLT code.
+	 */
+	acfg->stats.offsets_size += emit_offset_table (acfg, acfg->got_offset, 10, (gint32*)got_info_offsets);
 }
 
 static void
@@ -7740,6 +7759,139 @@ emit_dwarf_info (MonoAotCompile *acfg)
 #endif
 }
 
+static MonoImage*
+find_referenced_image (MonoAotCompile *acfg, const char *name)
+{
+	MonoImage *image = acfg->image;
+	int i;
+
+	if (!strcmp (image->assembly->aname.name, name))
+		return image;
+	if (!strcmp (mono_defaults.corlib->assembly->aname.name, name))
+		return mono_defaults.corlib;
+	for (i = 0; i < image->tables [MONO_TABLE_ASSEMBLYREF].rows; ++i) {
+		MonoAssembly *ref;
+
+		mono_assembly_load_reference (image, i);
+		ref = image->references [i];
+		if (ref && ref != REFERENCE_MISSING && !strcmp (ref->aname.name, name))
+			return ref->image;
+	}
+	return NULL;
+}
+
+/*
+ * add_logged_instance:
+ *
+ *   Add the generic instance described by LINE, which was written by
+ * log_missing_instance () in aot-runtime.c. Return whenever it was added.
+ * The format is:
+ * <assembly name>\t<token>\t<class inst argc>\t<method inst argc>\t<assembly qualified type names>...
+ */
+static gboolean
+add_logged_instance (MonoAotCompile *acfg, char *line)
+{
+	gchar **fields;
+	MonoImage *image;
+	MonoMethod *method;
+	MonoGenericContext ctx;
+	MonoType **argv;
+	int i, class_argc, method_argc;
+	gboolean in_image, res = FALSE;
+
+	fields = g_strsplit (line, "\t", -1);
+	if (g_strv_length (fields) < 4)
+		goto done;
+	class_argc = atoi (fields [2]);
+	method_argc = atoi (fields [3]);
+	if (class_argc < 0 || method_argc < 0 || g_strv_length (fields) != 4 + class_argc + method_argc)
+		goto done;
+
+	image = find_referenced_image (acfg, fields [0]);
+	if (!image)
+		goto done;
+	method = mono_get_method (image, strtoul (fields [1], NULL, 16), NULL);
+	if (!method) {
+		mono_loader_clear_error ();
+		goto done;
+	}
+	if ((method->klass->generic_container != NULL) != (class_argc > 0) || (mono_method_signature (method)->generic_param_count != method_argc))
+		goto done;
+
+	/*
+	 * Instances are added to the image of the generic definition or to the image of
+	 * one of the type arguments, like the ones found by add_generic_instances ().
+	 */
+	in_image = image == acfg->image;
+	argv = g_new0 (MonoType*, class_argc + method_argc);
+	for (i = 0; i < class_argc + method_argc; ++i) {
+		argv [i] = mono_reflection_type_from_name (fields [4 + i], acfg->image);
+		if (!argv [i]) {
+			mono_loader_clear_error ();
+			g_free (argv);
+			goto done;
+		}
+		if (mono_class_from_mono_type (argv [i])->image == acfg->image)
+			in_image = TRUE;
+	}
+
+	if (in_image) {
+		memset (&ctx, 0, sizeof (ctx));
+		if (class_argc)
+			ctx.class_inst = mono_metadata_get_generic_inst (class_argc, argv);
+		if (method_argc)
+			ctx.method_inst = mono_metadata_get_generic_inst (method_argc, argv + class_argc);
+		method = mono_class_inflate_generic_method (method, &ctx);
+
+		/* Fully sharable instances are already compiled in place of their definition */
+		if (!mono_method_is_generic_sharable_impl_full (method, FALSE, FALSE, FALSE)) {
+			add_extra_method (acfg, method);
+			res = TRUE;
+		}
+	}
+	g_free (argv);
+
+ done:
+	g_strfreev (fields);
+	return res;
+}
+
+/*
+ * add_logged_instances:
+ *
+ *   Add the generic instances which the runtime logged as missing from AOT images,
+ * see the MONO_AOT_LOG_INSTANCES env var in aot-runtime.c.
+ */
+static void
+add_logged_instances (MonoAotCompile *acfg)
+{
+	GSList *l;
+
+	for (l = acfg->aot_opts.instances_logs; l; l = l->next) {
+		const char *fname = l->data;
+		FILE *infile;
+		char line [4096];
+		int count = 0;
+
+		infile = fopen (fname, "r");
+		if (!infile) {
+			fprintf (stderr, "AOT : unable to open instances log '%s': %s\n", fname, strerror (errno));
+			exit (1);
+		}
+
+		while (fgets (line, sizeof (line), infile)) {
+			/* Kill the newline */
+			if (strlen (line) > 0 && line [strlen (line) - 1] == '\n')
+				line [strlen (line) - 1] = '\0';
+			if (add_logged_instance (acfg, line))
+				count ++;
+		}
+		fclose (infile);
+
+		printf ("Added %d generic instances from '%s'.\n", count, fname);
+	}
+}
+
 static void
 collect_methods (MonoAotCompile *acfg)
 {
@@ -7809,6 +7961,8 @@ collect_methods (MonoAotCompile *acfg)
 
 	add_generic_instances (acfg);
 
+	add_logged_instances (acfg);
+
 	if (acfg->aot_opts.full_aot)
 		add_wrappers (acfg);
 }
@@ -8019,6 +8173,109 @@ compile_asm (MonoAotCompile *acfg)
 	return 0;
 }
 
+/* Number of assemblies taken from/added to the AOT cache during this run */
+static int aot_cache_hits, aot_cache_misses;
+
+/*
+ * get_aot_cache_key:
+ *
+ *   Compute the name of the entry of the AOT cache which holds the output for
+ * the current assembly. It is a hash of everything the generated code depends
+ * on: the assembly itself, the GUIDs of the assemblies it references (the same
+ * check the AOT runtime does when loading the image), the runtime build, the
+ * optimization flags, the AOT and MONO_DEBUG options which affect code generation,
+ * the instances logs and the profile data files.
+ */
+static char*
+get_aot_cache_key (MonoAotCompile *acfg, const char *aot_options)
+{
+	MonoImage *image = acfg->image;
+	MonoDebugOptions *opt = mini_get_debug_options ();
+	MonoMD5Context ctx;
+	guchar digest [16];
+	GString *str;
+	gchar **args, **ptr;
+	char *build, *contents, *fname;
+	gsize len;
+	GSList *l;
+	int i;
+
+	str = g_string_new ("");
+	/* The file version is not bumped for every codegen change */
+	build = mono_get_runtime_build_info ();
+	g_string_append_printf (str, "%d|%s|%s|%x|%x|%d|", MONO_AOT_FILE_VERSION, build, AOT_TARGET_STR, acfg->opts, acfg->simd_opts, mono_use_llvm);
+	g_free (build);
+	/* The MONO_DEBUG options which change the generated code */
+	g_string_append_printf (str, "%d%d%d%d%d%d%d|", opt->better_cast_details, opt->mdb_optimizations, opt->gen_seq_points,
+			opt->explicit_null_checks, opt->init_stacks, opt->soft_breakpoints, opt->keep_frame_pointers);
+	args = g_strsplit (aot_options ? aot_options : "", ",", -1);
+	for (ptr = args; ptr && *ptr; ptr ++) {
+		/* These don't change the generated code */
+		if (str_begins_with (*ptr, "outfile=") || str_begins_with (*ptr, "cache-dir=") || str_begins_with (*ptr, "stats"))
+			continue;
+		g_string_append_printf (str, "%s|", *ptr);
+	}
+	g_strfreev (args);
+
+	mono_md5_init (&ctx);
+	mono_md5_update (&ctx, (guchar*)str->str, str->len);
+	mono_md5_update (&ctx, (guchar*)image->raw_data, image->raw_data_len);
+	for (l = acfg->aot_opts.instances_logs; l; l = l->next) {
+		if (g_file_get_contents (l->data, &contents, &len, NULL)) {
+			mono_md5_update (&ctx, (guchar*)contents, len);
+			g_free (contents);
+		}
+	}
+	/* The files read by load_profile_files () */
+	for (i = 0; ; ++i) {
+		fname = g_strdup_printf ("%s/.mono/aot-profile-data/%s-%d", g_get_home_dir (), image->assembly_name, i);
+		if (!g_file_test (fname, G_FILE_TEST_IS_REGULAR) || !g_file_get_contents (fname, &contents, &len, NULL)) {
+			g_free (fname);
+			break;
+		}
+		mono_md5_update (&ctx, (guchar*)contents, len);
+		g_free (contents);
+		g_free (fname);
+	}
+	for (i = 0; i < image->tables [MONO_TABLE_ASSEMBLYREF].rows; ++i) {
+		MonoAssembly *ref;
+
+		mono_assembly_load_reference (image, i);
+		ref = image->references [i];
+		if (ref && ref != REFERENCE_MISSING && ref->image->guid)
+			mono_md5_update (&ctx, (guchar*)ref->image->guid, strlen (ref->image->guid));
+	}
+	mono_md5_final (&ctx, digest);
+	g_string_free (str, TRUE);
+
+	str = g_string_new ("");
+	for (i = 0; i < 16; ++i)
+		g_string_append_printf (str, "%02x", digest [i]);
+	g_string_append (str, SHARED_EXT);
+	return g_string_free (str, FALSE);
+}
+
+static gboolean
+copy_file (const char *src, const char *dest)
+{
+	char *contents, *tmp_name;
+	gsize len;
+	gboolean res;
+
+	if (!g_file_get_contents (src, &contents, &len, NULL))
+		return FALSE;
+	/* Write to a temporary file first so concurrent readers never see partial files */
+	tmp_name = g_strdup_printf ("%s.tmp", dest);
+	res = g_file_set_contents (tmp_name, contents, len, NULL);
+	if (res && rename (tmp_name, dest) != 0) {
+		unlink (tmp_name);
+		res = FALSE;
+	}
+	g_free (tmp_name);
+	g_free (contents);
+	return res;
+}
+
 static MonoAotCompile*
 acfg_create (MonoAssembly *ass, guint32 opts)
 {
@@ -8067,7 +8324,8 @@ acfg_free (MonoAotCompile *acfg)
 {
 	int i;
 
-	img_writer_destroy (acfg->w);
+	if (acfg->w)
+		img_writer_destroy (acfg->w);
 	for (i = 0; i < acfg->nmethods; ++i)
 		if (acfg->cfgs [i])
 			g_free (acfg->cfgs [i]);
@@ -8109,6 +8367,7 @@ mono_compile_assembly (MonoAssembly *ass, guint32 opts, const char *aot_options)
 	int i, res;
 	MonoAotCompile *acfg;
 	char *outfile_name, *tmp_outfile_name, *p;
+	char *cache_file = NULL;
 	TV_DECLARE (atv);
 	TV_DECLARE (btv);
 
@@ -8177,6 +8436,38 @@ mono_compile_assembly (MonoAssembly *ass, guint32 opts, const char *aot_options)
 	if (acfg->aot_opts.full_aot)
 		acfg->flags |= MONO_AOT_FILE_FLAG_FULL_AOT;
 
+	/*
+	 * If the assembly and everything the generated code depends on is
+	 * unchanged since a previous run, reuse its output instead of compiling
+	 * the assembly again. Only shared library output is cached.
+	 */
+	if (acfg->aot_opts.cache_dir && !acfg->aot_opts.asm_only && !acfg->aot_opts.static_link && !acfg->llvm) {
+		char *key = get_aot_cache_key (acfg, aot_options);
+
+		cache_file = g_build_filename (acfg->aot_opts.cache_dir, key, NULL);
+		g_free (key);
+
+		if (g_file_test (cache_file, G_FILE_TEST_IS_REGULAR)) {
+			if (acfg->aot_opts.outfile)
+				outfile_name = g_strdup_printf ("%s", acfg->aot_opts.outfile);
+			else
+				outfile_name = g_strdup_printf ("%s%s", acfg->image->name, SHARED_EXT);
+
+			if (copy_file (cache_file, outfile_name)) {
+				aot_cache_hits ++;
+				printf ("Reused cached output '%s'.\n", cache_file);
+				if (acfg->aot_opts.stats)
+					printf ("AOT cache: %d hits, %d misses.\n", aot_cache_hits, aot_cache_misses);
+				g_free (outfile_name);
+				g_free (cache_file);
+				acfg_free (acfg);
+				return 0;
+			}
+			g_free (outfile_name);
+		}
+		aot_cache_misses ++;
+	}
+
 	load_profile_files (acfg);
 
 	acfg->num_trampolines [MONO_AOT_TRAMP_SPECIFIC] = acfg->aot_opts.full_aot ? acfg->aot_opts.ntrampolines : 0;
@@ -8462,6 +8753,19 @@ mono_compile_assembly (MonoAssembly *ass, guint32 opts, const char *aot_options)
 	TV_GETTIME (btv);
 	acfg->stats.link_time = TV_ELAPSED (atv, btv);
 
+	if (cache_file) {
+		if (!outfile_name) {
+			if (acfg->aot_opts.outfile)
+				outfile_name = g_strdup_printf ("%s", acfg->aot_opts.outfile);
+			else
+				outfile_name = g_strdup_printf ("%s%s", acfg->image->name, SHARED_EXT);
+		}
+		g_mkdir_with_parents (acfg->aot_opts.cache_dir, 0777);
+		if (!copy_file (outfile_name, cache_file))
+			fprintf (stderr, "AOT : unable to add '%s' to the cache.\n", outfile_name);
+		g_free (cache_file);
+	}
+
 	if (acfg->aot_opts.stats) {
 		int i;
 
@@ -8469,6 +8773,8 @@ mono_compile_assembly (MonoAssembly *ass, guint32 opts, const char *aot_options)
 		for (i = 0; i < MONO_PATCH_INFO_NONE; ++i)
 			if (acfg->stats.got_slot_types [i])
 				printf ("\t%s: %d (%d)\n", get_patch_name (i), acfg->stats.got_slot_types [i], acfg->stats.got_slot_info_sizes [i]);
+		if (acfg->aot_opts.cache_dir)
+			printf ("AOT cache: %d hits, %d misses.\n", aot_cache_hits, aot_cache_misses);
 	}
 
 	printf ("JIT time: %d ms, Generation time: %d ms, Assembly+Link time: %d ms.\n", acfg->stats.jit_time / 1000, acfg->stats.gen_time / 1000, acfg->stats.link_time / 1000);
@@ -54,10 +54,23 @@
 #include <mono/utils/mono-mmap.h>
 #include "mono/utils/mono-compiler.h"
 #include <mono/utils/mono-counters.h>
+#include <mono/utils/mono-time.h>
+#include <mono/utils/mono-semaphore.h>
 
 #include "mini.h"
 #include "version.h"
 
+/*
+ * Images written by the ELF writer in image-writer.c only contain RELATIVE
+ * relocations and no dependencies, so they can be mapped without going through
+ * the dynamic linker.
+ */
+#if defined(__linux__) && defined(HAVE_SYS_MMAN_H) && !defined(PLATFORM_ANDROID) && (defined(TARGET_AMD64) || defined(TARGET_X86) || (defined(TARGET_ARM) && !defined(TARGET_MACH)))
+#define MONO_AOT_DIRECT_MAP 1
+#include <mono/utils/freebsd-elf32.h>
+#include <mono/utils/freebsd-elf64.h>
+#endif
+
 #ifndef DISABLE_AOT
 
 #ifdef TARGET_WIN32
@@ -132,6 +145,8 @@ typedef struct MonoAotModule {
 
 	gpointer *globals;
 	MonoDl *sofile;
+	/* Set if the image was mapped by map_aot_image () instead of dlopen-ed */
+	struct MappedAotImage *mapped;
 } MonoAotModule;
 
 typedef struct {
@@ -163,6 +178,15 @@ static GHashTable *ji_to_amodule;
  */
 static gboolean use_aot_cache = FALSE;
 
+/*
+ * Whenever to map AOT images directly instead of loading them with the system
+ * dynamic linker. Mapped images are not visible to debuggers.
+ */
+static gboolean use_direct_map = FALSE;
+
+/* Time spent opening/mapping AOT images, in usecs */
+static gint64 aot_module_open_time;
+
 /*
  * Whenever to spawn a new process to AOT a file or do it in-process. Only relevant if
  * use_aot_cache is TRUE.
@@ -176,6 +200,25 @@ static gboolean make_unreadable = FALSE;
 static guint32 name_table_accesses = 0;
 static guint32 n_pagefaults = 0;
 
+/*
+ * Whenever to resolve the PLT entries of newly loaded AOT modules on a background
+ * thread instead of on the first call through them.
+ */
+static gboolean use_eager_plt = FALSE;
+/* AOT modules waiting to have their PLT resolved, protected by the AOT lock */
+static GSList *eager_plt_queue;
+static MonoSemType eager_plt_sem;
+static gboolean eager_plt_thread_started;
+static gint32 n_lazy_plt_resolves, n_eager_plt_resolves;
+
+/*
+ * File where generic instances missing from the AOT images are logged, so they can
+ * be passed to the AOT compiler using the 'instances-log' option.
+ */
+static FILE *instances_log;
+/* Instances already logged, protected by the AOT lock */
+static GHashTable *logged_instances;
+
 /* Used to speed-up find_aot_module () */
 static gsize aot_code_low_addr = (gssize)-1;
 static gsize aot_code_high_addr = 0;
@@ -195,6 +238,9 @@ static CRITICAL_SECTION aot_page_mutex;
 static void
 init_plt (MonoAotModule *info);
 
+static void
+queue_eager_plt (MonoAotModule *amodule);
+
 /*****************************************************/
 /*                 AOT RUNTIME                       */
 /*****************************************************/
@@ -1356,10 +1402,373 @@ load_aot_module_from_cache (MonoAssembly *assembly, char **aot_name)
 	return module;
 }
 
+typedef struct MappedAotImage {
+	guint8 *base;
+	gsize size;
+	guint32 *hash;
+	gpointer dynsym;
+	const char *dynstr;
+} MappedAotImage;
+
+#ifdef MONO_AOT_DIRECT_MAP
+
+#if SIZEOF_VOID_P == 4
+typedef Elf32_Ehdr ElfHeader;
+typedef Elf32_Phdr ElfProgHeader;
+typedef Elf32_Sym ElfSymbol;
+typedef Elf32_Rel ElfReloc;
+typedef Elf32_Rela ElfRelocA;
+typedef Elf32_Dyn ElfDynamic;
+#define ELF_CLASS ELFCLASS32
+#define ELF_R_TYPE(info) ELF32_R_TYPE (info)
+#else
+typedef Elf64_Ehdr ElfHeader;
+typedef Elf64_Phdr ElfProgHeader;
+typedef Elf64_Sym ElfSymbol;
+typedef Elf64_Rel ElfReloc;
+typedef Elf64_Rela ElfRelocA;
+typedef Elf64_Dyn ElfDynamic;
+#define ELF_CLASS ELFCLASS64
+#define ELF_R_TYPE(info) ELF64_R_TYPE (info)
+#endif
+
+#if defined(TARGET_AMD64)
+#define ELF_MACHINE EM_X86_64
+#define ELF_R_RELATIVE R_X86_64_RELATIVE
+#elif defined(TARGET_X86)
+#define ELF_MACHINE EM_386
+#define ELF_R_RELATIVE R_386_RELATIVE
+#else
+#define ELF_MACHINE EM_ARM
+#define ELF_R_RELATIVE R_ARM_RELATIVE
+#endif
+
+/*
+ * mapped_range_is_valid:
+ *
+ *   Return whenever the LEN bytes at OFFSET of the image are inside one of its
+ * loaded segments, a writable one if WRITABLE is set. The rest of the reserved
+ * range is not accessible.
+ */
+static gboolean
+mapped_range_is_valid (ElfProgHeader *phdrs, int phnum, guint64 offset, guint64 len, gboolean writable)
+{
+	int i;
+
+	for (i = 0; i < phnum; ++i) {
+		if (phdrs [i].p_type != PT_LOAD || (writable && !(phdrs [i].p_flags & PF_W)))
+			continue;
+		if (offset >= phdrs [i].p_vaddr && len <= phdrs [i].p_memsz && offset - phdrs [i].p_vaddr <= phdrs [i].p_memsz - len)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * map_aot_image:
+ *
+ *   Map the AOT image FNAME into memory without using the dynamic linker. Only
+ * images written by the ELF writer in image-writer.c are supported: they have no
+ * dependencies and only contain RELATIVE relocations, which are applied here.
+ * Return NULL and set ERR if the file is not such an image, the caller should
+ * fall back to dlopen () then. Every offset and size read from the file is
+ * checked against the mapped segments, and the symbol hash table is checked
+ * once here so mapped_aot_image_symbol () can trust it.
+ */
+static MappedAotImage*
+map_aot_image (const char *fname, char **err)
+{
+	MappedAotImage *image;
+	ElfHeader header;
+	ElfProgHeader *phdrs = NULL;
+	ElfDynamic *dyn;
+	ElfSymbol *syms;
+	struct stat st;
+	guint8 *base = MAP_FAILED;
+	gsize size = 0, dyn_vaddr = 0, dyn_size = 0, rel = 0, relsz = 0, rela = 0, relasz = 0;
+	gsize hash = 0, symtab = 0, strtab = 0, strsz = 0;
+	gsize page_size = mono_pagesize ();
+	guint32 *hash_table, nbucket, nchain;
+	int fd, i;
+
+	*err = NULL;
+
+	fd = open (fname, O_RDONLY);
+	if (fd == -1) {
+		*err = g_strdup_printf ("%s", strerror (errno));
+		return NULL;
+	}
+
+	if (fstat (fd, &st) != 0 ||
+		read (fd, &header, sizeof (header)) != sizeof (header) ||
+		memcmp (header.e_ident, ELFMAG, SELFMAG) != 0 ||
+		header.e_ident [EI_CLASS] != ELF_CLASS ||
+		header.e_type != ET_DYN || header.e_machine != ELF_MACHINE ||
+		header.e_phentsize != sizeof (ElfProgHeader)) {
+		*err = g_strdup ("not an ELF image of this architecture");
+		goto fail;
+	}
+
+	phdrs = g_new0 (ElfProgHeader, header.e_phnum);
+	if (pread (fd, phdrs, header.e_phnum * sizeof (ElfProgHeader), header.e_phoff) != header.e_phnum * sizeof (ElfProgHeader)) {
+		*err = g_strdup ("truncated program headers");
+		goto fail;
+	}
+
+	for (i = 0; i < header.e_phnum; ++i) {
+		switch (phdrs [i].p_type) {
+		case PT_LOAD:
+			if ((phdrs [i].p_vaddr & (page_size - 1)) != (phdrs [i].p_offset & (page_size - 1))) {
+				*err = g_strdup ("misaligned segment");
+				goto fail;
+			}
+			/* Mapping past the end of the file would fault on access */
+			if (phdrs [i].p_filesz > phdrs [i].p_memsz ||
+				phdrs [i].p_vaddr + phdrs [i].p_memsz < phdrs [i].p_vaddr ||
+				phdrs [i].p_vaddr + phdrs [i].p_memsz > (gsize)-1 - page_size ||
+				phdrs [i].p_offset > (guint64)st.st_size || phdrs [i].p_filesz > (guint64)st.st_size - phdrs [i].p_offset) {
+				*err = g_strdup ("invalid segment");
+				goto fail;
+			}
+			size = MAX (size, phdrs [i].p_vaddr + phdrs [i].p_memsz);
+			break;
+		case PT_DYNAMIC:
+			dyn_vaddr = phdrs [i].p_vaddr;
+			dyn_size = phdrs [i].p_memsz;
+			break;
+		case PT_GNU_STACK:
+			break;
+		default:
+			*err = g_strdup_printf ("unsupported program header type %d", (int)phdrs [i].p_type);
+			goto fail;
+		}
+	}
+	if (!size || !dyn_vaddr) {
+		*err = g_strdup ("no loadable segments");
+		goto fail;
+	}
+	if (!mapped_range_is_valid (phdrs, header.e_phnum, dyn_vaddr, dyn_size, FALSE) || (dyn_vaddr & (sizeof (gpointer) - 1))) {
+		*err = g_strdup ("invalid dynamic section");
+		goto fail;
+	}
+	size = (size + page_size - 1) & ~(page_size - 1);
+
+	/* Reserve the whole range first so the segments keep their relative positions */
+	base = mmap (NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) {
+		*err = g_strdup_printf ("%s", strerror (errno));
+		goto fail;
+	}
+
+	for (i = 0; i < header.e_phnum; ++i) {
+		ElfProgHeader *ph = &phdrs [i];
+		gsize start, file_end, file_page_end, mem_end;
+		int prot;
+
+		if (ph->p_type != PT_LOAD)
+			continue;
+
+		prot = PROT_READ;
+		if (ph->p_flags & PF_W)
+			prot |= PROT_WRITE;
+		if (ph->p_flags & PF_X)
+			prot |= PROT_EXEC;
+
+		start = ph->p_vaddr & ~(page_size - 1);
+		file_end = ph->p_vaddr + ph->p_filesz;
+		file_page_end = (file_end + page_size - 1) & ~(page_size - 1);
+		mem_end = ph->p_vaddr + ph->p_memsz;
+
+		if (ph->p_filesz && mmap (base + start, file_end - start, prot, MAP_PRIVATE | MAP_FIXED, fd, ph->p_offset & ~(page_size - 1)) == MAP_FAILED) {
+			*err = g_strdup_printf ("%s", strerror (errno));
+			goto fail;
+		}
+		if (mem_end > file_end) {
+			/* .bss */
+			if (!(prot & PROT_WRITE)) {
+				*err = g_strdup ("read-only segment with uninitialized data");
+				goto fail;
+			}
+			memset (base + file_end, 0, MIN (file_page_end, mem_end) - file_end);
+			if (mem_end > file_page_end && mmap (base + file_page_end, mem_end - file_page_end, prot, MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0) == MAP_FAILED) {
+				*err = g_strdup_printf ("%s", strerror (errno));
+				goto fail;
+			}
+		}
+	}
+
+	for (dyn = (ElfDynamic*)(base + dyn_vaddr); dyn < (ElfDynamic*)(base + dyn_vaddr) + dyn_size / sizeof (ElfDynamic) && dyn->d_tag != DT_NULL; ++dyn) {
+		switch (dyn->d_tag) {
+		case DT_NEEDED:
+			*err = g_strdup ("image has dependencies");
+			goto fail;
+		case DT_HASH:
+			hash = dyn->d_un.d_val;
+			break;
+		case DT_SYMTAB:
+			symtab = dyn->d_un.d_val;
+			break;
+		case DT_STRTAB:
+			strtab = dyn->d_un.d_val;
+			break;
+		case DT_STRSZ:
+			strsz = dyn->d_un.d_val;
+			break;
+		case DT_REL:
+			rel = dyn->d_un.d_val;
+			break;
+		case DT_RELSZ:
+			relsz = dyn->d_un.d_val;
+			break;
+		case DT_RELA:
+			rela = dyn->d_un.d_val;
+			break;
+		case DT_RELASZ:
+			relasz = dyn->d_un.d_val;
+			break;
+		default:
+			break;
+		}
+	}
+	if (!hash || !symtab || !strtab || !strsz) {
+		*err = g_strdup ("no dynamic symbol table");
+		goto fail;
+	}
+
+	/*
+	 * Check the tables mapped_aot_image_symbol () reads. The image writer only aligns
+	 * the tables following .hash to 4 bytes.
+	 */
+	if (!mapped_range_is_valid (phdrs, header.e_phnum, hash, 2 * sizeof (guint32), FALSE) || (hash & 3) || (symtab & 3))
+		goto invalid_symtab;
+	hash_table = (guint32*)(base + hash);
+	nbucket = hash_table [0];
+	nchain = hash_table [1];
+	if (!nbucket ||
+		!mapped_range_is_valid (phdrs, header.e_phnum, hash, (2 + (guint64)nbucket + nchain) * sizeof (guint32), FALSE) ||
+		!mapped_range_is_valid (phdrs, header.e_phnum, symtab, (guint64)nchain * sizeof (ElfSymbol), FALSE) ||
+		!mapped_range_is_valid (phdrs, header.e_phnum, strtab, strsz, FALSE) ||
+		base [strtab + strsz - 1] != 0)
+		goto invalid_symtab;
+	for (i = 0; i < nbucket + nchain; ++i) {
+		if (hash_table [2 + i] >= nchain)
+			goto invalid_symtab;
+	}
+	syms = (ElfSymbol*)(base + symtab);
+	for (i = 0; i < nchain; ++i) {
+		if (syms [i].st_name >= strsz || (syms [i].st_shndx != SHN_UNDEF && syms [i].st_value >= size))
+			goto invalid_symtab;
+	}
+
+	if ((relsz && !mapped_range_is_valid (phdrs, header.e_phnum, rel, relsz, FALSE)) ||
+		(relasz && !mapped_range_is_valid (phdrs, header.e_phnum, rela, relasz, FALSE)) ||
+		(rel & 3) || (rela & 3)) {
+		*err = g_strdup ("invalid relocation table");
+		goto fail;
+	}
+
+	for (i = 0; i < relsz / sizeof (ElfReloc); ++i) {
+		ElfReloc *r = (ElfReloc*)(base + rel) + i;
+
+		if (ELF_R_TYPE (r->r_info) != ELF_R_RELATIVE || !mapped_range_is_valid (phdrs, header.e_phnum, r->r_offset, sizeof (gpointer), TRUE)) {
+			*err = g_strdup ("unsupported relocation");
+			goto fail;
+		}
+		*(gsize*)(base + r->r_offset) += (gsize)base;
+	}
+	for (i = 0; i < relasz / sizeof (ElfRelocA); ++i) {
+		ElfRelocA *r = (ElfRelocA*)(base + rela) + i;
+
+		if (ELF_R_TYPE (r->r_info) != ELF_R_RELATIVE || !mapped_range_is_valid (phdrs, header.e_phnum, r->r_offset, sizeof (gpointer), TRUE)) {
+			*err = g_strdup ("unsupported relocation");
+			goto fail;
+		}
+		*(gsize*)(base + r->r_offset) = (gsize)base + r->r_addend;
+	}
+
+	close (fd);
+	g_free (phdrs);
+
+	image = g_new0 (MappedAotImage, 1);
+	image->base = base;
+	image->size = size;
+	image->hash = (guint32*)(base + hash);
+	image->dynsym = base + symtab;
+	image->dynstr = (const char*)(base + strtab);
+	return image;
+
+ invalid_symtab:
+	*err = g_strdup ("invalid dynamic symbol table");
+ fail:
+	if (base != MAP_FAILED)
+		munmap (base, size);
+	g_free (phdrs);
+	close (fd);
+	return NULL;
+}
+
+static void
+unmap_aot_image (MappedAotImage *image)
+{
+	munmap (image->base, image->size);
+	g_free (image);
+}
+
+static gpointer
+mapped_aot_image_symbol (MappedAotImage *image, const char *name)
+{
+	ElfSymbol *syms = image->dynsym;
+	guint32 nbucket = image->hash [0];
+	guint32 *bucket = image->hash + 2;
+	guint32 *chain = bucket + nbucket;
+	const unsigned char *p;
+	guint32 h = 0, g, i;
+
+	/* The standard SysV ELF hash, see elf_hash () in image-writer.c */
+	for (p = (const unsigned char*)name; *p; ++p) {
+		h = (h << 4) + *p;
+		if ((g = h & 0xf0000000))
+			h ^= g >> 24;
+		h &= ~g;
+	}
+
+	for (i = bucket [h % nbucket]; i != STN_UNDEF; i = chain [i]) {
+		if (syms [i].st_shndx != SHN_UNDEF && !strcmp (image->dynstr + syms [i].st_name, name))
+			return image->base + syms [i].st_value;
+	}
+	return NULL;
+}
+
+#else
+
+static MappedAotImage*
+map_aot_image (const char *fname, char **err)
+{
+	*err = g_strdup ("not supported on this platform");
+	return NULL;
+}
+
+static void
+unmap_aot_image (MappedAotImage *image)
+{
+	g_assert_not_reached ();
+}
+
+static gpointer
+mapped_aot_image_symbol (MappedAotImage *image, const char *name)
+{
+	g_assert_not_reached ();
+	return NULL;
+}
+
+#endif /* MONO_AOT_DIRECT_MAP */
+
 static void
-find_symbol (MonoDl *module, gpointer *globals, const char *name, gpointer *value)
+find_symbol (MonoDl *module, MappedAotImage *mapped, gpointer *globals, const char *name, gpointer *value)
 {
-	if (globals) {
+	if (mapped) {
+		*value = mapped_aot_image_symbol (mapped, name);
+	} else if (globals) {
 		int global_index;
 		guint16 *table, *entry;
 		guint16 table_size;
@@ -1497,6 +1906,7 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 	char *aot_name;
 	MonoAotModule *amodule;
 	MonoDl *sofile;
+	MappedAotImage *mapped = NULL;
 	gboolean usable = TRUE;
 	char *version_symbol = NULL;
 	char *msg = NULL;
@@ -1540,18 +1950,33 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 			sofile = load_aot_module_from_cache (assembly, &aot_name);
 		else {
 			char *err;
+			gint64 start = mono_100ns_ticks ();
+
 			aot_name = g_strdup_printf ("%s%s", assembly->image->name, SHARED_EXT);
 
-			sofile = mono_dl_open (aot_name, MONO_DL_LAZY, &err);
+			sofile = NULL;
+			if (use_direct_map) {
+				mapped = map_aot_image (aot_name, &err);
+				if (!mapped) {
+					mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT unable to map AOT module %s directly: %s\n", aot_name, err);
+					g_free (err);
+				}
+			}
 
-			if (!sofile) {
-				mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT failed to load AOT module %s: %s\n", aot_name, err);
-				g_free (err);
+			if (!mapped) {
+				sofile = mono_dl_open (aot_name, MONO_DL_LAZY, &err);
+
+				if (!sofile) {
+					mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT failed to load AOT module %s: %s\n", aot_name, err);
+					g_free (err);
+				}
 			}
+
+			aot_module_open_time += (mono_100ns_ticks () - start) / 10;
 		}
 	}
 
-	if (!sofile && !globals) {
+	if (!sofile && !mapped && !globals) {
 		if (mono_aot_only && assembly->image->tables [MONO_TABLE_METHOD].rows) {
 			fprintf (stderr, "Failed to load AOT module '%s' in aot-only mode.\n", aot_name);
 			exit (1);
@@ -1561,8 +1986,8 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 	}
 
 	if (!info) {
-		find_symbol (sofile, globals, "mono_aot_version", (gpointer *) &version_symbol);
-		find_symbol (sofile, globals, "mono_aot_file_info", (gpointer*)&info);
+		find_symbol (sofile, mapped, globals, "mono_aot_version", (gpointer *) &version_symbol);
+		find_symbol (sofile, mapped, globals, "mono_aot_file_info", (gpointer*)&info);
 	}
 
 	if (version_symbol) {
@@ -1591,6 +2016,8 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 		g_free (aot_name);
 		if (sofile)
 			mono_dl_close (sofile);
+		if (mapped)
+			unmap_aot_image (mapped);
 		assembly->image->aot_module = NULL;
 		return;
 	}
@@ -1611,6 +2038,7 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 	amodule->got [0] = assembly->image;
 	amodule->globals = globals;
 	amodule->sofile = sofile;
+	amodule->mapped = mapped;
 	amodule->method_to_code = g_hash_table_new (mono_aligned_addr_hash, NULL);
 	amodule->blob = blob;
 
@@ -1732,7 +2160,7 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 
 	if (mono_aot_only) {
 		char *code;
-		find_symbol (amodule->sofile, amodule->globals, "specific_trampolines_page", (gpointer *)&code);
+		find_symbol (amodule->sofile, amodule->mapped, amodule->globals, "specific_trampolines_page", (gpointer *)&code);
 		amodule->use_page_trampolines = code != NULL;
 		/*g_warning ("using page trampolines: %d", amodule->use_page_trampolines);*/
 		if (mono_defaults.corlib) {
@@ -1785,6 +2213,9 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 	}
 	else
 		mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT loaded AOT Module for %s.\n", assembly->image->name);
+
+	if (use_eager_plt && !amodule->out_of_date)
+		queue_eager_plt (amodule);
 }
 
 /*
@@ -1846,6 +2277,22 @@ mono_aot_init (void)
 		mono_last_aot_method = atoi (g_getenv ("MONO_LASTAOT"));
 	if (g_getenv ("MONO_AOT_CACHE"))
 		use_aot_cache = TRUE;
+	if (g_getenv ("MONO_AOT_MMAP"))
+		use_direct_map = TRUE;
+	if (g_getenv ("MONO_AOT_LOG_INSTANCES")) {
+		instances_log = fopen (g_getenv ("MONO_AOT_LOG_INSTANCES"), "a");
+		if (!instances_log)
+			g_warning ("Unable to open AOT instances log '%s': %s", g_getenv ("MONO_AOT_LOG_INSTANCES"), strerror (errno));
+		logged_instances = g_hash_table_new (NULL, NULL);
+	}
+	if (g_getenv ("MONO_AOT_EAGER_PLT")) {
+		use_eager_plt = TRUE;
+		MONO_SEM_INIT (&eager_plt_sem, 0);
+	}
+
+	mono_counters_register ("AOT module open time", MONO_COUNTER_JIT | MONO_COUNTER_TIME_INTERVAL, &aot_module_open_time);
+	mono_counters_register ("AOT lazy PLT resolves", MONO_COUNTER_JIT | MONO_COUNTER_INT, &n_lazy_plt_resolves);
+	mono_counters_register ("AOT eager PLT resolves", MONO_COUNTER_JIT | MONO_COUNTER_INT, &n_eager_plt_resolves);
 }
 
 void
@@ -3182,9 +3629,13 @@ load_method (MonoDomain *domain, MonoAotModule *amodule, MonoImage *image, MonoM
 			mono_mempool_destroy (mp);
 	}
 
-	if (mini_get_debug_options ()->load_aot_jit_info_eagerly)
+	if (mini_get_debug_options ()->load_aot_jit_info_eagerly || mono_jit_map_is_enabled ())
 		jinfo = mono_aot_find_jit_info (domain, amodule->assembly->image, code);
 
+	/* AOT code is in the perf map too, so profiles don't depend on the symbols of the AOT image */
+	if (jinfo && mono_jit_map_is_enabled ())
+		mono_emit_jit_map (jinfo);
+
 	if (mono_trace_is_traced (G_LOG_LEVEL_DEBUG, MONO_TRACE_AOT)) {
 		char *full_name;
 
@@ -3377,6 +3828,59 @@ find_extra_method (MonoMethod *method, MonoAotModule **out_amodule)
 	return index;
 }
 
+static void
+append_generic_inst (GString *str, MonoGenericInst *inst)
+{
+	int i;
+
+	for (i = 0; inst && i < inst->type_argc; ++i) {
+		char *name = mono_type_get_name_full (inst->type_argv [i], MONO_TYPE_NAME_FORMAT_ASSEMBLY_QUALIFIED);
+
+		g_string_append_printf (str, "\t%s", name);
+		g_free (name);
+	}
+}
+
+/*
+ * log_missing_instance:
+ *
+ *   Log the generic instance METHOD which was not found in any AOT image. The
+ * format is parsed by add_logged_instance () in aot-compiler.c.
+ */
+static void
+log_missing_instance (MonoMethod *method)
+{
+	MonoMethod *declaring = mono_method_get_declaring_generic_method (method);
+	MonoGenericContext *ctx = mono_method_get_context (method);
+	GString *str;
+	gboolean logged;
+
+	if (!declaring->token || (ctx->class_inst && ctx->class_inst->is_open) || (ctx->method_inst && ctx->method_inst->is_open))
+		return;
+
+	mono_aot_lock ();
+	logged = g_hash_table_lookup (logged_instances, method) != NULL;
+	if (!logged)
+		g_hash_table_insert (logged_instances, method, method);
+	mono_aot_unlock ();
+	if (logged)
+		return;
+
+	str = g_string_new ("");
+	g_string_append_printf (str, "%s\t%08x\t%d\t%d", declaring->klass->image->assembly->aname.name, declaring->token,
+							ctx->class_inst ? ctx->class_inst->type_argc : 0, ctx->method_inst ? ctx->method_inst->type_argc : 0);
+	append_generic_inst (str, ctx->class_inst);
+	append_generic_inst (str, ctx->method_inst);
+	g_string_append_c (str, '\n');
+
+	mono_aot_lock ();
+	fputs (str->str, instances_log);
+	fflush (instances_log);
+	mono_aot_unlock ();
+
+	g_string_free (str, TRUE);
+}
+
 /*
  * mono_aot_get_method:
  *
@@ -3528,6 +4032,8 @@ mono_aot_get_method (MonoDomain *domain, MonoMethod *method)
 		}
 
 		if (method_index == 0xffffff) {
+			if (instances_log && method->is_inflated && !method->wrapper_type)
+				log_missing_instance (method);
 			if (mono_aot_only && mono_trace_is_traced (G_LOG_LEVEL_DEBUG, MONO_TRACE_AOT)) {
 				char *full_name;
 
@@ -3675,6 +4181,8 @@ mono_aot_plt_resolve (gpointer aot_module, guint32 plt_info_offset, guint8 *code
 
 	//printf ("DYN: %p %d\n", aot_module, plt_info_offset);
 
+	InterlockedIncrement (&n_lazy_plt_resolves);
+
 	p = &module->blob [plt_info_offset];
 
 	ji.type = decode_value (p, &p);
@@ -3770,6 +4278,165 @@ init_plt (MonoAotModule *amodule)
 	amodule->plt_inited = TRUE;
 }
 
+/*
+ * resolve_eager_plt_target:
+ *
+ *   Return the target of the PLT patch JI if it can be computed without running
+ * managed code or creating trampolines, NULL otherwise.
+ */
+static gpointer
+resolve_eager_plt_target (MonoDomain *domain, MonoJumpInfo *ji)
+{
+	MonoMethod *method;
+	MonoVTable *vtable;
+	gpointer code;
+
+	switch (ji->type) {
+	case MONO_PATCH_INFO_ABS:
+	case MONO_PATCH_INFO_JIT_ICALL_ADDR:
+	case MONO_PATCH_INFO_ICALL_ADDR:
+		/* These are already function pointers, see mono_aot_plt_resolve () */
+		return mono_resolve_patch_target (NULL, domain, NULL, ji, FALSE);
+	case MONO_PATCH_INFO_CLASS_INIT:
+		/* Creating the vtable might fail, so only use existing ones */
+		vtable = mono_class_try_get_vtable (domain, ji->data.klass);
+		if (!vtable)
+			return NULL;
+		return mono_create_class_init_trampoline (vtable);
+	case MONO_PATCH_INFO_METHOD:
+		method = ji->data.method;
+		/* Same as the full-aot fast path in mono_aot_plt_resolve () */
+		if (method->is_generic || mono_method_check_context_used (method) || (method->iflags & METHOD_IMPL_ATTRIBUTE_SYNCHRONIZED) ||
+			mono_method_needs_static_rgctx_invoke (method, FALSE))
+			return NULL;
+#ifdef MONO_ARCH_GSHAREDVT_SUPPORTED
+		return NULL;
+#endif
+		if (!mono_class_init (method->klass))
+			return NULL;
+		/* Calling the method might have to run its cctor, leave that to the trampoline */
+		if (method->klass->has_cctor) {
+			vtable = mono_class_try_get_vtable (domain, method->klass);
+			if (!vtable || !vtable->initialized)
+				return NULL;
+		}
+		/* Only use AOT code, JITting is left to the trampoline */
+		code = mono_aot_get_method (domain, method);
+		if (!code)
+			return NULL;
+		return mono_create_ftnptr (domain, code);
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * resolve_plt_eagerly:
+ *
+ *   Resolve the PLT entries of AMODULE whose targets are safe to compute ahead of
+ * time, so the first calls through them don't need to go through the PLT
+ * trampoline. PLT entries are numbered in the order the methods referencing them
+ * were emitted, so this follows the code layout of the image.
+ */
+static void
+resolve_plt_eagerly (MonoAotModule *amodule)
+{
+	MonoDomain *domain = mono_get_root_domain ();
+	gpointer *got = amodule->got;
+	gpointer tramp;
+	MonoMemPool *mp;
+	int i;
+
+	mono_aot_lock ();
+	init_plt (amodule);
+	mono_aot_unlock ();
+
+	tramp = got [amodule->info.plt_got_offset_base + 1];
+
+	mp = mono_mempool_new_size (512);
+	for (i = 1; i < amodule->info.plt_size; ++i) {
+		guint32 got_offset = amodule->info.plt_got_offset_base + i;
+		MonoJumpInfo ji;
+		guint8 *p;
+		gpointer target;
+
+		/* Already resolved by a call through it */
+		if (got [got_offset] != tramp)
+			continue;
+
+		p = amodule->blob + mono_aot_get_offset (amodule->got_info_offsets, got_offset);
+		memset (&ji, 0, sizeof (ji));
+		ji.type = decode_value (p, &p);
+		if (ji.type != MONO_PATCH_INFO_ABS && ji.type != MONO_PATCH_INFO_JIT_ICALL_ADDR && ji.type != MONO_PATCH_INFO_ICALL_ADDR &&
+			ji.type != MONO_PATCH_INFO_CLASS_INIT && ji.type != MONO_PATCH_INFO_METHOD)
+			continue;
+		if (!decode_patch (amodule, mp, &ji, p, &p))
+			continue;
+
+		target = resolve_eager_plt_target (domain, &ji);
+		if (target && InterlockedCompareExchangePointer (&got [got_offset], target, tramp) == tramp)
+			InterlockedIncrement (&n_eager_plt_resolves);
+	}
+	mono_mempool_destroy (mp);
+
+	mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT resolved PLT of %s.\n", amodule->aot_name);
+}
+
+static guint32
+eager_plt_thread (gpointer unused)
+{
+	MonoAotModule *amodule;
+
+	while (TRUE) {
+		if (MONO_SEM_WAIT (&eager_plt_sem) != 0)
+			continue;
+
+		mono_aot_lock ();
+		amodule = eager_plt_queue ? eager_plt_queue->data : NULL;
+		eager_plt_queue = g_slist_delete_link (eager_plt_queue, eager_plt_queue);
+		mono_aot_unlock ();
+
+		if (amodule)
+			resolve_plt_eagerly (amodule);
+	}
+
+	return 0;
+}
+
+/*
+ * queue_eager_plt:
+ *
+ *   Queue AMODULE for eager PLT resolution. The thread doing it can only be
+ * created once the threading subsystem is up, so modules loaded before that,
+ * like corlib's, are processed when the first module after it is loaded.
+ */
+static void
+queue_eager_plt (MonoAotModule *amodule)
+{
+	gboolean start_thread = FALSE;
+
+	if (amodule->info.plt_size <= 1)
+		return;
+
+	mono_aot_lock ();
+	eager_plt_queue = g_slist_append (eager_plt_queue, amodule);
+	/* Threads can only be created once the current thread is attached to the runtime */
+	if (!eager_plt_thread_started && mono_thread_internal_current ()) {
+		eager_plt_thread_started = TRUE;
+		start_thread = TRUE;
+	}
+	mono_aot_unlock ();
+
+	MONO_SEM_POST (&eager_plt_sem);
+
+	if (start_thread) {
+		MonoInternalThread *thread = mono_thread_create_internal (mono_get_root_domain (), eager_plt_thread, NULL, FALSE, FALSE, 0);
+
+		if (thread)
+			mono_thread_set_state (thread, ThreadState_Background);
+	}
+}
+
 /*
  * mono_aot_get_plt_entry:
  *
@@ -3885,7 +4552,7 @@ load_function_full (MonoAotModule *amodule, const char *name, MonoTrampInfo **ou
 	/* Load the code */
 
 	symbol = g_strdup_printf ("%s", name);
-	find_symbol (amodule->sofile, amodule->globals, symbol, (gpointer *)&code);
+	find_symbol (amodule->sofile, amodule->mapped, amodule->globals, symbol, (gpointer *)&code);
 	g_free (symbol);
 	if (!code)
 		g_error ("Symbol '%s' not found in AOT file '%s'.\n", name, amodule->aot_name);
@@ -3895,7 +4562,7 @@ load_function_full (MonoAotModule *amodule, const char *name, MonoTrampInfo **ou
 	/* Load info */
 
 	symbol = g_strdup_printf ("%s_p", name);
-	find_symbol (amodule->sofile, amodule->globals, symbol, (gpointer *)&p);
+	find_symbol (amodule->sofile, amodule->mapped, amodule->globals, symbol, (gpointer *)&p);
 	g_free (symbol);
 	if (!p)
 		/* Nothing to patch */
@@ -1002,6 +1002,7 @@ static void main_thread_handler (gpointer user_data)
 			fprintf (stderr, "Can not open image %s\n", main_args->file);
 			exit (1);
 		}
+		mono_assembly_prefetch_references (assembly);
 
 		/* 
 		 * This must be done in a thread managed by mono since it can invoke
@@ -1134,6 +1135,7 @@ mini_usage (void)
 		"    --profile[=profiler]   Runs in profiling mode with the specified profiler module\n"
 		"    --trace[=EXPR]         Enable tracing, use --help-trace for details\n"
 		"    --jitmap               Output a jit method map to /tmp/perf-PID.map\n"
+		"    --jitdump              Also output a jitdump file to /tmp/jit-PID.dump\n"
 		"    --help-devel           Shows more options available to developers\n"
 #ifdef __native_client_codegen__
 		"    --nacl-align-mask-off  Turn off Native Client 32-byte alignment mask (for debug only)\n"
@@ -1384,7 +1386,37 @@ mono_set_use_smp (int use_smp)
 	}
 #endif
 }
-	
+
+/*
+ * probe_embedded:
+ *
+ *   If mkbundle --mmap appended a bundle of assemblies to this executable, register
+ * them, and insert the name of the main assembly into the command line, so it is
+ * run with the arguments the executable was invoked with.
+ */
+static void
+probe_embedded (int *ref_argc, char **ref_argv [])
+{
+	int argc = *ref_argc;
+	char **argv = *ref_argv;
+	char **new_argv;
+	const char *main_name;
+
+#ifdef __linux__
+	main_name = mono_register_bundled_assemblies_from_file ("/proc/self/exe");
+#else
+	main_name = mono_register_bundled_assemblies_from_file (argv [0]);
+#endif
+	if (!main_name)
+		return;
+
+	new_argv = g_new0 (char*, argc + 2);
+	new_argv [0] = argv [0];
+	new_argv [1] = (char*)main_name;
+	memcpy (new_argv + 2, argv + 1, (argc - 1) * sizeof (char*));
+	*ref_argc = argc + 1;
+	*ref_argv = new_argv;
+}
 
 /**
  * mono_main:
@@ -1444,6 +1476,8 @@ mono_main (int argc, char* argv[])
 	g_log_set_always_fatal (G_LOG_LEVEL_ERROR);
 	g_log_set_fatal_mask (G_LOG_DOMAIN, G_LOG_LEVEL_ERROR);
 
+	probe_embedded (&argc, &argv);
+
 	opt = parse_optimizations (NULL);
 
 	for (i = 1; i < argc; ++i) {
@@ -1612,6 +1646,8 @@ mono_main (int argc, char* argv[])
 			forced_version = &argv [i][10];
 		} else if (strcmp (argv [i], "--jitmap") == 0) {
 			mono_enable_jit_map ();
+		} else if (strcmp (argv [i], "--jitdump") == 0) {
+			mono_enable_jit_dump ();
 		} else if (strcmp (argv [i], "--profile") == 0) {
 			enable_profile = TRUE;
 			profile_options = NULL;
@@ -1457,6 +1457,8 @@ mono_arch_compute_omit_fp (MonoCompile *cfg)
 
 	if (!debug_omit_fp ())
 		cfg->arch.omit_fp = FALSE;
+	if (mini_get_debug_options ()->keep_frame_pointers)
+		cfg->arch.omit_fp = FALSE;
 	/*
 	if (cfg->method->save_lmf)
 		cfg->arch.omit_fp = FALSE;
@@ -858,6 +858,71 @@ mono_walk_stack_full (MonoJitStackWalk func, MonoContext *start_ctx, MonoDomain
 	}
 }
 
+/*
+ * mono_walk_stack_ips_async_safe:
+ *
+ *   Store the ip at START_CTX followed by the ips of the managed frames below it on the
+ * stack of the current thread into IPS, storing at most MAX_IPS entries, and return
+ * the number of entries stored. This is meant to be called from the signal handler
+ * of sampling profilers: it doesn't allocate or take locks, and it doesn't resolve
+ * methods, the ips can be passed to mono_jit_info_table_find () later, outside the
+ * signal handler. Unwinding uses the decoded unwind info cache in unwind.c, so it is
+ * cheap enough for high sampling frequencies.
+ * AOT methods whose jit info hasn't been decoded yet can't be unwound, the walk
+ * continues from the LMF of the closest managed-to-native transition, and ends if
+ * there is none, or the method which made the transition can't be found either.
+ */
+int
+mono_walk_stack_ips_async_safe (MonoContext *start_ctx, gpointer *ips, int max_ips)
+{
+	MonoDomain *domain = mono_domain_get ();
+	MonoDomain *root_domain = mono_get_root_domain ();
+	MonoJitTlsData *jit_tls = mono_native_tls_get_value (mono_jit_tls_id);
+	MonoLMF *lmf = mono_get_lmf ();
+	MonoContext ctx, new_ctx;
+	StackFrameInfo frame;
+	MonoJitInfo *ji;
+	gboolean first = TRUE;
+	int count = 0;
+
+	if (max_ips <= 0)
+		return 0;
+
+	ctx = *start_ctx;
+	ips [count ++] = MONO_CONTEXT_GET_IP (&ctx);
+
+	if (!domain || !jit_tls)
+		return count;
+
+	/* The arch unwinder looks up the ip of LMF frames with mini_jit_info_table_find () */
+	jit_tls->async_safe_walk = TRUE;
+
+	while (count < max_ips && MONO_CONTEXT_GET_SP (&ctx) < jit_tls->end_of_stack) {
+		gpointer ip = MONO_CONTEXT_GET_IP (&ctx);
+
+		ji = mono_jit_info_table_find_internal (domain, ip, FALSE);
+		if (!ji && domain != root_domain)
+			ji = mono_jit_info_table_find_internal (root_domain, ip, FALSE);
+
+		/*
+		 * If IP is native code, or an AOT method we can't look up here, this continues
+		 * from the LMF, and fails if there is none.
+		 */
+		if (!mono_arch_find_jit_info (domain, jit_tls, ji, &ctx, &new_ctx, &lmf, NULL, &frame))
+			break;
+
+		if (frame.type == FRAME_TYPE_MANAGED && !first)
+			ips [count ++] = ip;
+
+		first = FALSE;
+		ctx = new_ctx;
+	}
+
+	jit_tls->async_safe_walk = FALSE;
+
+	return count;
+}
+
 MonoBoolean
 ves_icall_get_frame_info (gint32 skip, MonoBoolean need_file_info, 
 			  MonoReflectionMethod **method, 
@@ -1041,20 +1106,16 @@ callback_get_stack_frames_security_info (StackFrameInfo *frame, MonoContext *ctx
 }
 
 static MonoArray *
-glist_to_array (GList *list, MonoClass *eclass) 
+buffer_to_array (gpointer *buf, int len, MonoClass *eclass) 
 {
 	MonoDomain *domain = mono_domain_get ();
 	MonoArray *res;
-	int len, i;
 
-	if (!list)
+	if (!len)
 		return NULL;
 
-	len = g_list_length (list);
 	res = mono_array_new (domain, eclass, len);
-
-	for (i = 0; list; list = list->next, i++)
-		mono_array_set (res, gpointer, i, list->data);
+	memcpy (mono_array_addr (res, gpointer, 0), buf, len * sizeof (gpointer));
 
 	return res;
 }
@@ -1126,12 +1187,14 @@ mini_jit_info_table_find (MonoDomain *domain, char *addr, MonoDomain **out_domai
 {
 	MonoJitInfo *ji;
 	MonoInternalThread *t = mono_thread_internal_current ();
+	MonoJitTlsData *jit_tls = mono_native_tls_get_value (mono_jit_tls_id);
+	gboolean try_aot = !(jit_tls && jit_tls->async_safe_walk);
 	gpointer *refs;
 
 	if (out_domain)
 		*out_domain = NULL;
 
-	ji = mono_jit_info_table_find (domain, addr);
+	ji = mono_jit_info_table_find_internal (domain, addr, try_aot);
 	if (ji) {
 		if (out_domain)
 			*out_domain = domain;
@@ -1140,7 +1203,7 @@ mini_jit_info_table_find (MonoDomain *domain, char *addr, MonoDomain **out_domai
 
 	/* maybe it is shared code, so we also search in the root domain */
 	if (domain != mono_get_root_domain ()) {
-		ji = mono_jit_info_table_find (mono_get_root_domain (), addr);
+		ji = mono_jit_info_table_find_internal (mono_get_root_domain (), addr, try_aot);
 		if (ji) {
 			if (out_domain)
 				*out_domain = mono_get_root_domain ();
@@ -1151,7 +1214,7 @@ mini_jit_info_table_find (MonoDomain *domain, char *addr, MonoDomain **out_domai
 	refs = (t->appdomain_refs) ? *(gpointer *) t->appdomain_refs : NULL;
 	for (; refs && *refs; refs++) {
 		if (*refs != domain && *refs != mono_get_root_domain ()) {
-			ji = mono_jit_info_table_find ((MonoDomain*) *refs, addr);
+			ji = mono_jit_info_table_find_internal ((MonoDomain*) *refs, addr, try_aot);
 			if (ji) {
 				if (out_domain)
 					*out_domain = (MonoDomain*) *refs;
@@ -1259,17 +1322,33 @@ build_native_trace (void)
 #endif
 }
 
+/*
+ * The trace is collected as raw ip/generic info pairs into a buffer owned by
+ * JIT_TLS, so throwing doesn't allocate anything besides the final array.
+ * Filters can throw while the buffer is in use, those nested exceptions use
+ * a buffer of their own. JIT_TLS always points to the current buffer, since
+ * an exception escaping a filter never returns to release_trace_ips (); the
+ * buffer then stays marked as in use, and is freed with JIT_TLS.
+ */
 #define setup_managed_stacktrace_information() do {	\
 	if (mono_ex && !initial_trace_ips) {	\
-		trace_ips = g_list_reverse (trace_ips);	\
-		MONO_OBJECT_SETREF (mono_ex, trace_ips, glist_to_array (trace_ips, mono_defaults.int_class));	\
+		MONO_OBJECT_SETREF (mono_ex, trace_ips, buffer_to_array (trace_ips, trace_ips_len, mono_defaults.int_class));	\
 		MONO_OBJECT_SETREF (mono_ex, native_trace_ips, build_native_trace ());	\
 		if (has_dynamic_methods)	\
 			/* These methods could go away anytime, so compute the stack trace now */	\
 			MONO_OBJECT_SETREF (mono_ex, stack_trace, ves_icall_System_Exception_get_trace (mono_ex));	\
 	}	\
-	g_list_free (trace_ips);	\
-	trace_ips = NULL;	\
+	trace_ips_len = 0;	\
+} while (0)
+
+#define release_trace_ips() do {	\
+	if (trace_ips_borrowed) {	\
+		jit_tls->trace_ips = trace_ips;	\
+		jit_tls->trace_ips_size = trace_ips_size;	\
+		jit_tls->trace_ips_in_use = FALSE;	\
+	} else {	\
+		g_free (trace_ips);	\
+	}	\
 } while (0)
 /*
  * mono_handle_exception_internal_first_pass:
@@ -1287,7 +1366,9 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gint3
 	MonoJitTlsData *jit_tls = mono_native_tls_get_value (mono_jit_tls_id);
 	MonoLMF *lmf = mono_get_lmf ();
 	MonoArray *initial_trace_ips = NULL;
-	GList *trace_ips = NULL;
+	gpointer *trace_ips = NULL;
+	int trace_ips_len = 0, trace_ips_size = 0;
+	gboolean trace_ips_borrowed = FALSE;
 	MonoException *mono_ex;
 	gboolean stack_overflow = FALSE;
 	MonoContext initial_ctx;
@@ -1325,6 +1406,13 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gint3
 	filter_idx = 0;
 	initial_ctx = *ctx;
 
+	if (!jit_tls->trace_ips_in_use) {
+		jit_tls->trace_ips_in_use = TRUE;
+		trace_ips = jit_tls->trace_ips;
+		trace_ips_size = jit_tls->trace_ips_size;
+		trace_ips_borrowed = TRUE;
+	}
+
 	while (1) {
 		MonoContext new_ctx;
 		guint32 free_stack;
@@ -1345,6 +1433,7 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gint3
 
 		if (!unwind_res) {
 			setup_managed_stacktrace_information ();
+			release_trace_ips ();
 			return FALSE;
 		}
 
@@ -1364,9 +1453,17 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gint3
 			 * overflow.
 			 */
 			if (!initial_trace_ips && (frame_count < 1000)) {
-				trace_ips = g_list_prepend (trace_ips, MONO_CONTEXT_GET_IP (ctx));
-				trace_ips = g_list_prepend (trace_ips,
-											get_generic_info_from_stack_frame (ji, ctx));
+				if (trace_ips_len + 2 > trace_ips_size) {
+					trace_ips_size = MAX (trace_ips_size * 2, 64);
+					trace_ips = g_renew (gpointer, trace_ips, trace_ips_size);
+					if (trace_ips_borrowed) {
+						/* An exception escaping a filter unwinds this frame without releasing the buffer */
+						jit_tls->trace_ips = trace_ips;
+						jit_tls->trace_ips_size = trace_ips_size;
+					}
+				}
+				trace_ips [trace_ips_len ++] = MONO_CONTEXT_GET_IP (ctx);
+				trace_ips [trace_ips_len ++] = get_generic_info_from_stack_frame (ji, ctx);
 			}
 		}
 
@@ -1445,6 +1542,7 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gint3
 					if (filtered) {
 						if (!is_user_frame)
 							setup_managed_stacktrace_information ();
+						release_trace_ips ();
 						/* mono_debugger_agent_handle_exception () needs this */
 						MONO_CONTEXT_SET_IP (ctx, ei->handler_start);
 						return TRUE;
@@ -1453,6 +1551,7 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gint3
 
 				if (ei->flags == MONO_EXCEPTION_CLAUSE_NONE && mono_object_isinst (ex_obj, catch_class)) {
 					setup_managed_stacktrace_information ();
+					release_trace_ips ();
 
 					if (out_ji)
 						*out_ji = ji;
@@ -12,6 +12,7 @@
 
 #include <mono/metadata/class.h>
 #include <mono/utils/mono-counters.h>
+#include <mono/utils/mono-memory-model.h>
 
 #include "mini.h"
 
@@ -1546,10 +1547,17 @@ mono_class_rgctx_get_array_size (int n, gboolean mrgctx)
 {
 	g_assert (n >= 0 && n < 30);
 
+	/*
+	 * Make the first array big enough for the slots most shared methods
+	 * use, so they are reached with a single indirection.  The MRGCTX
+	 * header lives in its first array, too.  The lazy fetch trampolines
+	 * and AOT images bake these sizes in, so bump MONO_AOT_FILE_VERSION
+	 * when changing them.
+	 */
 	if (mrgctx)
-		return 6 << n;
+		return 10 << n;
 	else
-		return 4 << n;
+		return 8 << n;
 }
 
 /*
@@ -1649,17 +1657,18 @@ fill_runtime_generic_context (MonoVTable *class_vtable, MonoRuntimeGenericContex
 		g_print ("filling mrgctx slot %d table %d index %d\n", slot, i, rgctx_index);
 	*/
 
-	/*FIXME We should use CAS here, no need to take a lock.*/
-	mono_domain_lock (domain);
-
-	/* Check whether the slot hasn't been instantiated in the
-	   meantime. */
-	if (rgctx [rgctx_index])
-		info = rgctx [rgctx_index];
-	else
-		rgctx [rgctx_index] = info;
-
-	mono_domain_unlock (domain);
+	/*
+	 * Publish the slot without taking the domain lock.  The lookup side
+	 * doesn't lock either, so make sure the instantiated info is visible
+	 * before the pointer to it.  If another thread filled the slot in the
+	 * meantime, use its value.
+	 */
+	mono_memory_barrier ();
+	{
+		gpointer prev = InterlockedCompareExchangePointer (&rgctx [rgctx_index], info, NULL);
+		if (prev)
+			info = prev;
+	}
 
 	if (do_free)
 		free_inflated_info (oti.info_type, oti.data);
@@ -349,25 +349,8 @@ SIG_HANDLER_SIGNATURE (sigprof_signal_handler)
 #endif
 			}
 
-			if (call_chain_strategy == MONO_PROFILER_CALL_CHAIN_MANAGED) {
-				MonoDomain *domain = mono_domain_get ();
-				if (domain != NULL) {
-					MonoLMF *lmf = NULL;
-					MonoJitInfo *ji;
-					MonoJitInfo res;
-					MonoContext new_mono_context;
-					int native_offset;
-					ji = mono_find_jit_info (domain, jit_tls, &res, NULL, &mono_context,
-							&new_mono_context, NULL, &lmf, &native_offset, NULL);
-					while ((ji != NULL) && (current_frame_index <= call_chain_depth)) {
-						ips [current_frame_index] = MONO_CONTEXT_GET_IP (&new_mono_context);
-						current_frame_index ++;
-						mono_context = new_mono_context;
-						ji = mono_find_jit_info (domain, jit_tls, &res, NULL, &mono_context,
-								&new_mono_context, NULL, &lmf, &native_offset, NULL);
-					}
-				}
-			}
+			if (call_chain_strategy == MONO_PROFILER_CALL_CHAIN_MANAGED)
+				current_frame_index = mono_walk_stack_ips_async_safe (&mono_context, (gpointer*)ips, call_chain_depth + 1);
 		}
 		
 		mono_profiler_stat_call_chain (current_frame_index, & ips [0], ctx);
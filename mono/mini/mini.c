@@ -23,6 +23,12 @@
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
 #endif
+#ifdef __linux__
+/* For the jitdump file */
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
 
 #include <mono/utils/memcheck.h>
 
@@ -49,6 +55,7 @@
 #include <mono/metadata/mempool-internals.h>
 #include <mono/metadata/attach.h>
 #include <mono/metadata/runtime.h>
+#include <mono/metadata/layout-cache.h>
 #include <mono/utils/mono-math.h>
 #include <mono/utils/mono-compiler.h>
 #include <mono/utils/mono-counters.h>
@@ -2760,6 +2767,7 @@ free_jit_tls_data (MonoJitTlsData *jit_tls)
 	mono_free_altstack (jit_tls);
 
 	g_free (jit_tls->first_lmf);
+	g_free (jit_tls->trace_ips);
 	g_free (jit_tls);
 }
 
@@ -5432,6 +5440,58 @@ lookup_method (MonoDomain *domain, MonoMethod *method)
 #if ENABLE_JIT_MAP
 static FILE* perf_map_file = NULL;
 
+/*
+ * Records written to the jitdump file, see tools/perf/Documentation/jitdump-specification.txt
+ * in the linux sources. 'perf inject --jit' uses them to create an ELF image for every
+ * method, so 'perf report' can show the code of managed methods too.
+ */
+#define JITDUMP_MAGIC 0x4A695444
+#define JITDUMP_VERSION 1
+#define JITDUMP_CODE_LOAD 0
+#define JITDUMP_CODE_CLOSE 3
+
+typedef struct {
+	guint32 magic;
+	guint32 version;
+	guint32 total_size;
+	guint32 elf_mach;
+	guint32 pad1;
+	guint32 pid;
+	guint64 timestamp;
+	guint64 flags;
+} JitDumpHeader;
+
+typedef struct {
+	guint32 id;
+	guint32 total_size;
+	guint64 timestamp;
+} JitDumpRecordHeader;
+
+typedef struct {
+	JitDumpRecordHeader header;
+	guint32 pid;
+	guint32 tid;
+	guint64 vma;
+	guint64 code_addr;
+	guint64 code_size;
+	guint64 code_index;
+	/* followed by the name and the code */
+} JitDumpCodeLoad;
+
+static FILE *jit_dump_file;
+static void *jit_dump_marker;
+static guint64 jit_dump_code_index;
+
+static guint64
+jit_dump_timestamp (void)
+{
+	struct timespec ts;
+
+	/* perf needs to be told to use the same clock with 'perf record -k mono' */
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (guint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 void
 mono_enable_jit_map (void)
 {
@@ -5443,11 +5503,106 @@ mono_enable_jit_map (void)
 	}
 }
 
+/*
+ * mono_enable_jit_dump:
+ *
+ *   Write a jitdump file to /tmp/jit-PID.dump in addition to the perf map, which
+ * also contains the code of every method.
+ */
+void
+mono_enable_jit_dump (void)
+{
+	JitDumpHeader header;
+	char name [64];
+
+	if (jit_dump_file)
+		return;
+
+	mono_enable_jit_map ();
+
+	g_snprintf (name, sizeof (name), "/tmp/jit-%d.dump", getpid ());
+	unlink (name);
+	jit_dump_file = fopen (name, "w+");
+	if (!jit_dump_file)
+		return;
+
+	memset (&header, 0, sizeof (header));
+	header.magic = JITDUMP_MAGIC;
+	header.version = JITDUMP_VERSION;
+	header.total_size = sizeof (header);
+#if defined(TARGET_AMD64)
+	header.elf_mach = 62; /* EM_X86_64 */
+#elif defined(TARGET_X86)
+	header.elf_mach = 3; /* EM_386 */
+#elif defined(TARGET_ARM)
+	header.elf_mach = 40; /* EM_ARM */
+#endif
+	header.pid = getpid ();
+	header.timestamp = jit_dump_timestamp ();
+	fwrite (&header, sizeof (header), 1, jit_dump_file);
+	fflush (jit_dump_file);
+
+	/* perf record finds the file through this executable mapping */
+	jit_dump_marker = mmap (NULL, getpagesize (), PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno (jit_dump_file), 0);
+	if (jit_dump_marker == MAP_FAILED)
+		jit_dump_marker = NULL;
+}
+
+static void
+mono_emit_jit_dump (void *start, int size, const char *desc)
+{
+	JitDumpCodeLoad record;
+	int name_len = strlen (desc) + 1;
+
+	memset (&record, 0, sizeof (record));
+	record.header.id = JITDUMP_CODE_LOAD;
+	record.header.total_size = sizeof (record) + name_len + size;
+	record.header.timestamp = jit_dump_timestamp ();
+	record.pid = getpid ();
+	record.tid = syscall (SYS_gettid);
+	record.vma = (gsize)start;
+	record.code_addr = (gsize)start;
+	record.code_size = size;
+
+	flockfile (jit_dump_file);
+	record.code_index = jit_dump_code_index ++;
+	fwrite (&record, sizeof (record), 1, jit_dump_file);
+	fwrite (desc, name_len, 1, jit_dump_file);
+	fwrite (start, size, 1, jit_dump_file);
+	funlockfile (jit_dump_file);
+}
+
+/*
+ * mono_jit_map_cleanup:
+ *
+ *   Flush the map files at shutdown. They are not closed, since other threads might
+ * still be running code which is being compiled.
+ */
+static void
+mono_jit_map_cleanup (void)
+{
+	if (jit_dump_file) {
+		JitDumpRecordHeader header;
+
+		header.id = JITDUMP_CODE_CLOSE;
+		header.total_size = sizeof (header);
+		header.timestamp = jit_dump_timestamp ();
+		flockfile (jit_dump_file);
+		fwrite (&header, sizeof (header), 1, jit_dump_file);
+		fflush (jit_dump_file);
+		funlockfile (jit_dump_file);
+	}
+	if (perf_map_file)
+		fflush (perf_map_file);
+}
+
 void
 mono_emit_jit_tramp (void *start, int size, const char *desc)
 {
 	if (perf_map_file)
 		fprintf (perf_map_file, "%llx %x %s\n", (long long unsigned int)(gsize)start, size, desc);
+	if (jit_dump_file)
+		mono_emit_jit_dump (start, size, desc);
 }
 
 void
@@ -6050,6 +6205,7 @@ mono_jit_runtime_invoke (MonoMethod *method, void *obj, void **params, MonoObjec
 	MonoDomain *domain = mono_domain_get ();
 	MonoJitDomainInfo *domain_info;
 	RuntimeInvokeInfo *info, *info2;
+	gpointer *cache_slot;
 	
 	if (obj == NULL && !(method->flags & METHOD_ATTRIBUTE_STATIC) && !method->string_ctor && (method->wrapper_type == 0)) {
 		g_warning ("Ignoring invocation of an instance method on a NULL instance.\n");
@@ -6058,9 +6214,21 @@ mono_jit_runtime_invoke (MonoMethod *method, void *obj, void **params, MonoObjec
 
 	domain_info = domain_jit_info (domain);
 
-	mono_domain_lock (domain);
-	info = g_hash_table_lookup (domain_info->runtime_invoke_hash, method);
-	mono_domain_unlock (domain);		
+	/*
+	 * Infos live as long as the domain, so repeated invokes of the same method can
+	 * find theirs without taking the domain lock. Dynamic methods are left out since
+	 * they can be freed and their address reused.
+	 */
+	cache_slot = &domain_info->runtime_invoke_cache [mono_aligned_addr_hash (method) & (RUNTIME_INVOKE_CACHE_SIZE - 1)];
+	info = *cache_slot;
+	if (!info || info->method != method) {
+		mono_domain_lock (domain);
+		info = g_hash_table_lookup (domain_info->runtime_invoke_hash, method);
+		mono_domain_unlock (domain);
+
+		if (info && !method->dynamic)
+			*cache_slot = info;
+	}
 
 	if (!info) {
 		if (mono_security_get_mode () == MONO_SECURITY_MODE_CORE_CLR) {
@@ -6079,6 +6247,7 @@ mono_jit_runtime_invoke (MonoMethod *method, void *obj, void **params, MonoObjec
 		}
 
 		info = g_new0 (RuntimeInvokeInfo, 1);
+		info->method = method;
 
 		invoke = mono_marshal_get_runtime_invoke (method, FALSE);
 		info->vtable = mono_class_vtable_full (domain, method->klass, TRUE);
@@ -6192,6 +6361,12 @@ mono_jit_runtime_invoke (MonoMethod *method, void *obj, void **params, MonoObjec
 			g_hash_table_insert (domain_info->runtime_invoke_hash, method, info);
 		}
 		mono_domain_unlock (domain);
+
+		if (!method->dynamic) {
+			/* Make the info visible before publishing it to lock-free readers */
+			mono_memory_barrier ();
+			*cache_slot = info;
+		}
 	}
 
 	runtime_invoke = info->runtime_invoke;
@@ -6521,9 +6696,11 @@ mini_parse_debug_options (void)
 			debug_options.better_cast_details = TRUE;
 		else if (!strcmp (arg, "soft-breakpoints"))
 			debug_options.soft_breakpoints = TRUE;
+		else if (!strcmp (arg, "keep-frame-pointers"))
+			debug_options.keep_frame_pointers = TRUE;
 		else {
 			fprintf (stderr, "Invalid option for the MONO_DEBUG env variable: %s\n", arg);
-			fprintf (stderr, "Available options: 'handle-sigint', 'keep-delegates', 'reverse-pinvoke-exceptions', 'collect-pagefault-stats', 'break-on-unverified', 'no-gdb-backtrace', 'dont-free-domains', 'suspend-on-sigsegv', 'suspend-on-unhandled', 'dyn-runtime-invoke', 'gdb', 'explicit-null-checks', 'init-stacks'\n");
+			fprintf (stderr, "Available options: 'handle-sigint', 'keep-delegates', 'reverse-pinvoke-exceptions', 'collect-pagefault-stats', 'break-on-unverified', 'no-gdb-backtrace', 'dont-free-domains', 'suspend-on-sigsegv', 'suspend-on-unhandled', 'dyn-runtime-invoke', 'gdb', 'explicit-null-checks', 'init-stacks', 'keep-frame-pointers'\n");
 			exit (1);
 		}
 	}
@@ -6688,6 +6865,7 @@ mini_init (const char *filename, const char *runtime_version)
 	MonoDomain *domain;
 	MonoRuntimeCallbacks callbacks;
 	MonoThreadInfoRuntimeCallbacks ticallbacks;
+	char *build_info;
 
 	MONO_VES_INIT_BEGIN ();
 
@@ -6838,6 +7016,9 @@ mini_init (const char *filename, const char *runtime_version)
 	mono_install_runtime_invoke (mono_jit_runtime_invoke);
 #endif
 	mono_install_get_cached_class_info (mono_aot_get_cached_class_info);
+	build_info = mono_get_runtime_build_info ();
+	mono_layout_cache_init (build_info);
+	g_free (build_info);
 	mono_install_get_class_from_name (mono_aot_get_class_from_name);
  	mono_install_jit_info_find_in_aot (mono_aot_find_jit_info);
 
@@ -7211,6 +7392,10 @@ mini_cleanup (MonoDomain *domain)
 	/* This accesses metadata so needs to be called before runtime shutdown */
 	print_jit_stats ();
 
+#if ENABLE_JIT_MAP
+	mono_jit_map_cleanup ();
+#endif
+
 	mono_profiler_shutdown ();
 
 #ifndef MONO_CROSS_COMPILE
@@ -127,7 +127,7 @@
 #endif
 
 /* Version number of the AOT file format */
-#define MONO_AOT_FILE_VERSION 88
+#define MONO_AOT_FILE_VERSION 90
 
 //TODO: This is x86/amd64 specific.
 #define mono_simd_shuffle_mask(a,b,c,d) ((a) | ((b) << 2) | ((c) << 4) | ((d) << 6))
@@ -276,6 +276,8 @@ typedef struct MonoAotFileInfo
 } MonoAotFileInfo;
 
 /* Per-domain information maintained by the JIT */
+#define RUNTIME_INVOKE_CACHE_SIZE 256
+
 typedef struct
 {
 	/* Maps MonoMethod's to a GSList of GOT slot addresses pointing to its code */
@@ -293,6 +295,8 @@ typedef struct
 	GHashTable *method_code_hash;
 	/* Maps methods to a RuntimeInvokeInfo structure */
 	GHashTable *runtime_invoke_hash;
+	/* Direct mapped front end of runtime_invoke_hash, read without locking */
+	gpointer runtime_invoke_cache [RUNTIME_INVOKE_CACHE_SIZE];
 	/* Maps MonoMethod to a GPtrArray containing sequence point locations */
 	GHashTable *seq_points;
 	/* Debugger agent data */
@@ -1031,6 +1035,19 @@ typedef struct {
 	 */
 	MonoContext orig_ex_ctx;
 	gboolean orig_ex_ctx_set;
+
+	/*
+	 * Buffer used to collect the trace of an exception during the first pass,
+	 * reused between throws.
+	 */
+	gpointer *trace_ips;
+	int trace_ips_size;
+	gboolean trace_ips_in_use;
+	/*
+	 * Set while mono_walk_stack_ips_async_safe () runs, makes mini_jit_info_table_find ()
+	 * skip the AOT lookup, which takes locks and allocates.
+	 */
+	gboolean async_safe_walk;
 } MonoJitTlsData;
 
 /*
@@ -1730,6 +1747,11 @@ typedef struct {
 	 * Load AOT JIT info eagerly.
 	 */
 	gboolean load_aot_jit_info_eagerly;
+	/*
+	 * Don't use the frame pointer as a general register, so native profilers can
+	 * walk the stack through JITted frames.
+	 */
+	gboolean keep_frame_pointers;
 } MonoDebugOptions;
 
 enum {
@@ -2290,6 +2312,7 @@ void     mono_print_thread_dump_from_ctx        (MonoContext *ctx);
 void     mono_walk_stack_with_ctx               (MonoJitStackWalk func, MonoContext *start_ctx, MonoUnwindOptions unwind_options, void *user_data) MONO_INTERNAL;
 void     mono_walk_stack_with_state             (MonoJitStackWalk func, MonoThreadUnwindState *state, MonoUnwindOptions unwind_options, void *user_data) MONO_INTERNAL;
 void     mono_walk_stack                        (MonoJitStackWalk func, MonoUnwindOptions options, void *user_data) MONO_INTERNAL;
+int      mono_walk_stack_ips_async_safe         (MonoContext *start_ctx, gpointer *ips, int max_ips) MONO_INTERNAL;
 gboolean mono_thread_state_init_from_sigctx     (MonoThreadUnwindState *ctx, void *sigctx) MONO_INTERNAL;
 gboolean mono_thread_state_init_from_current    (MonoThreadUnwindState *ctx) MONO_INTERNAL;
 gboolean mono_thread_state_init_from_monoctx    (MonoThreadUnwindState *ctx, MonoContext *mctx) MONO_INTERNAL;
@@ -2577,11 +2600,13 @@ void        mono_simd_intrinsics_init (void) MONO_INTERNAL;
 /* maybe enable also for other systems? */
 #define ENABLE_JIT_MAP 1
 void mono_enable_jit_map (void) MONO_INTERNAL;
+void mono_enable_jit_dump (void) MONO_INTERNAL;
 void mono_emit_jit_map   (MonoJitInfo *jinfo) MONO_INTERNAL;
 void mono_emit_jit_tramp (void *start, int size, const char *desc) MONO_INTERNAL;
 gboolean mono_jit_map_is_enabled (void) MONO_INTERNAL;
 #else
 #define mono_enable_jit_map()
+#define mono_enable_jit_dump()
 #define mono_emit_jit_map(ji)
 #define mono_emit_jit_tramp(s,z,d)
 #define mono_jit_map_is_enabled() (0)
@@ -31,6 +31,22 @@ typedef struct {
 	guint8 info [MONO_ZERO_LEN_ARRAY];
 } MonoUnwindInfo;
 
+/*
+ * DecodedUnwindInfo:
+ *
+ *   The unwind state at the end of an unwind info blob, i.e. the state which holds
+ * for every ip after the prolog. Unwind info blobs live as long as the runtime,
+ * so they are keyed by their address.
+ */
+typedef struct {
+	guint8 *unwind_info;
+	guint32 unwind_info_len;
+	/* The state below is valid for code offsets >= this */
+	int prolog_len;
+	int cfa_reg, cfa_offset;
+	Loc locations [MONO_ZERO_LEN_ARRAY];
+} DecodedUnwindInfo;
+
 static CRITICAL_SECTION unwind_mutex;
 
 static MonoUnwindInfo **cached_info;
@@ -38,6 +54,20 @@ static int cached_info_next, cached_info_size;
 static GSList *cached_info_list;
 /* Statistics */
 static int unwind_info_size;
+static int decoded_unwind_hits, decoded_unwind_misses;
+
+/*
+ * The decoded unwind info cache is used from signal handlers too, so entries are
+ * allocated from a static pool and published with a CAS into an open addressed
+ * hash table. Entries are never removed.
+ */
+#define DECODED_UNWIND_POOL_SIZE 512
+#define DECODED_UNWIND_HASH_SIZE 1024
+#define DECODED_UNWIND_PROBES 8
+
+static guint8 *decoded_unwind_pool;
+static volatile gint32 decoded_unwind_pool_next;
+static DecodedUnwindInfo * volatile decoded_unwind_hash [DECODED_UNWIND_HASH_SIZE];
 
 #define unwind_lock() EnterCriticalSection (&unwind_mutex)
 #define unwind_unlock() LeaveCriticalSection (&unwind_mutex)
@@ -342,6 +372,70 @@ print_dwarf_state (int cfa_reg, int cfa_offset, int ip, int nregs, Loc *location
 	printf ("\n");
 }
 
+#define DECODED_UNWIND_INFO_SIZE (sizeof (DecodedUnwindInfo) + NUM_REGS * sizeof (Loc))
+
+#define DECODED_UNWIND_HASH(info) ((((gsize)(info)) >> 2) & (DECODED_UNWIND_HASH_SIZE - 1))
+
+static DecodedUnwindInfo*
+find_decoded_unwind_info (guint8 *unwind_info, guint32 unwind_info_len)
+{
+	int i, hash = DECODED_UNWIND_HASH (unwind_info);
+
+	for (i = 0; i < DECODED_UNWIND_PROBES; ++i) {
+		DecodedUnwindInfo *decoded = decoded_unwind_hash [(hash + i) & (DECODED_UNWIND_HASH_SIZE - 1)];
+
+		if (!decoded)
+			return NULL;
+		if (decoded->unwind_info == unwind_info && decoded->unwind_info_len == unwind_info_len)
+			return decoded;
+	}
+	return NULL;
+}
+
+/*
+ * add_decoded_unwind_info:
+ *
+ *   Remember the final unwind state of UNWIND_INFO. This is signal safe: if the pool
+ * is exhausted or the hash chain is full, nothing is cached.
+ */
+static void
+add_decoded_unwind_info (guint8 *unwind_info, guint32 unwind_info_len, int prolog_len, int cfa_reg, int cfa_offset, Loc *locations)
+{
+	DecodedUnwindInfo *decoded;
+	guint32 index;
+	int i, hash;
+
+	if (!decoded_unwind_pool)
+		return;
+
+	/* Don't bump the counter once the pool is full, so it can't wrap around */
+	do {
+		index = decoded_unwind_pool_next;
+		if (index >= DECODED_UNWIND_POOL_SIZE)
+			return;
+	} while (InterlockedCompareExchange (&decoded_unwind_pool_next, index + 1, index) != index);
+
+	decoded = (DecodedUnwindInfo*)(decoded_unwind_pool + index * DECODED_UNWIND_INFO_SIZE);
+	decoded->unwind_info = unwind_info;
+	decoded->unwind_info_len = unwind_info_len;
+	decoded->prolog_len = prolog_len;
+	decoded->cfa_reg = cfa_reg;
+	decoded->cfa_offset = cfa_offset;
+	memcpy (decoded->locations, locations, NUM_REGS * sizeof (Loc));
+	mono_memory_barrier ();
+
+	hash = DECODED_UNWIND_HASH (unwind_info);
+	for (i = 0; i < DECODED_UNWIND_PROBES; ++i) {
+		DecodedUnwindInfo * volatile *slot = &decoded_unwind_hash [(hash + i) & (DECODED_UNWIND_HASH_SIZE - 1)];
+
+		if (InterlockedCompareExchangePointer ((gpointer volatile*)slot, decoded, NULL) == NULL)
+			return;
+		/* Another thread might have added the same info */
+		if ((*slot)->unwind_info == unwind_info && (*slot)->unwind_info_len == unwind_info_len)
+			return;
+	}
+}
+
 /*
  * Given the state of the current frame as stored in REGS, execute the unwind 
  * operations in unwind_info until the location counter reaches POS. The result is 
@@ -357,10 +451,26 @@ mono_unwind_frame (guint8 *unwind_info, guint32 unwind_info_len,
 				   mgreg_t **save_locations, int save_locations_len,
 				   guint8 **out_cfa)
 {
-	Loc locations [NUM_REGS];
+	Loc locations_buf [NUM_REGS];
+	Loc *locations = locations_buf;
 	int i, pos, reg, cfa_reg, cfa_offset;
 	guint8 *p;
 	guint8 *cfa_val;
+	DecodedUnwindInfo *decoded;
+
+	/*
+	 * Most frames are past their prolog, where the unwind state is the same for
+	 * every ip, so use the decoded state instead of interpreting the unwind ops.
+	 */
+	decoded = find_decoded_unwind_info (unwind_info, unwind_info_len);
+	if (decoded && ip - start_ip >= decoded->prolog_len) {
+		decoded_unwind_hits ++;
+		locations = decoded->locations;
+		cfa_reg = decoded->cfa_reg;
+		cfa_offset = decoded->cfa_offset;
+		goto apply;
+	}
+	decoded_unwind_misses ++;
 
 	for (i = 0; i < NUM_REGS; ++i)
 		locations [i].loc_type = LOC_SAME;
@@ -417,6 +527,10 @@ mono_unwind_frame (guint8 *unwind_info, guint32 unwind_info_len,
 		}
 	}
 
+	if (!decoded && p >= unwind_info + unwind_info_len)
+		add_decoded_unwind_info (unwind_info, unwind_info_len, pos, cfa_reg, cfa_offset, locations);
+
+ apply:
 	if (save_locations)
 		memset (save_locations, 0, save_locations_len * sizeof (mgreg_t*));
 
@@ -439,7 +553,11 @@ mono_unwind_init (void)
 {
 	InitializeCriticalSection (&unwind_mutex);
 
+	decoded_unwind_pool = g_malloc0 (DECODED_UNWIND_POOL_SIZE * DECODED_UNWIND_INFO_SIZE);
+
 	mono_counters_register ("Unwind info size", MONO_COUNTER_JIT | MONO_COUNTER_INT, &unwind_info_size);
+	mono_counters_register ("Decoded unwind info hits", MONO_COUNTER_JIT | MONO_COUNTER_INT, &decoded_unwind_hits);
+	mono_counters_register ("Decoded unwind info misses", MONO_COUNTER_JIT | MONO_COUNTER_INT, &decoded_unwind_misses);
 }
 
 void
@@ -449,6 +567,10 @@ mono_unwind_cleanup (void)
 
 	DeleteCriticalSection (&unwind_mutex);
 
+	memset ((gpointer)decoded_unwind_hash, 0, sizeof (decoded_unwind_hash));
+	g_free (decoded_unwind_pool);
+	decoded_unwind_pool = NULL;
+
 	if (!cached_info)
 		return;
 
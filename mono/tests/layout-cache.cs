@@ -0,0 +1,272 @@
+//
+// layout-cache.cs: exercises class layout, for the MONO_LAYOUT_CACHE test
+//
+// The output only depends on the behavior of the program, so it must be the
+// same with or without the layout cache, and with a cold or a warm one. When
+// compiled with -d:V2, the types have the same names and field counts, but a
+// different layout, to check that the cache of the first version is not used.
+//
+
+using System;
+using System.Runtime.InteropServices;
+
+interface IShape {
+	double Area ();
+	string Name { get; }
+}
+
+interface IScalable {
+	void Scale (int factor);
+}
+
+interface ITagged {
+	int Tag { get; }
+}
+
+struct Point {
+#if V2
+	public long X;
+	public int Y;
+#else
+	public int X;
+	public long Y;
+#endif
+
+	public Point (int x, int y)
+	{
+		X = x;
+		Y = y;
+	}
+
+	public override string ToString ()
+	{
+		return "(" + X + "," + Y + ")";
+	}
+}
+
+struct Line {
+	public Point From;
+	public object Label;
+	public Point To;
+}
+
+[StructLayout (LayoutKind.Explicit)]
+struct Overlay {
+	[FieldOffset (0)] public long Wide;
+#if V2
+	[FieldOffset (4)] public int Low;
+#else
+	[FieldOffset (0)] public int Low;
+#endif
+	[FieldOffset (8)] public double Real;
+}
+
+[StructLayout (LayoutKind.Sequential, Pack = 1)]
+struct Packed {
+	public byte A;
+	public int B;
+	public short C;
+}
+
+abstract class Shape : IShape {
+	static int created;
+	protected string name;
+	public int Id;
+
+	protected Shape (string name)
+	{
+		this.name = name;
+		Id = ++created;
+	}
+
+	public abstract double Area ();
+
+	public virtual string Name {
+		get { return name; }
+	}
+
+	public static int Created {
+		get { return created; }
+	}
+}
+
+class Rect : Shape, IScalable {
+#if V2
+	public object Owner;
+	public int W, H;
+#else
+	public int W, H;
+	public object Owner;
+#endif
+	public Point Origin;
+
+	public Rect (int w, int h) : base ("rect")
+	{
+		W = w;
+		H = h;
+		Owner = "owner" + w;
+		Origin = new Point (w, h);
+	}
+
+	public override double Area ()
+	{
+		return W * H;
+	}
+
+	public virtual void Scale (int factor)
+	{
+		W *= factor;
+		H *= factor;
+	}
+}
+
+sealed class Square : Rect, ITagged {
+	public byte Flags;
+	public string Note;
+
+	public Square (int s) : base (s, s)
+	{
+		Flags = (byte) s;
+		Note = "square" + s;
+	}
+
+	public override string Name {
+		get { return "square:" + base.Name; }
+	}
+
+	public override void Scale (int factor)
+	{
+		base.Scale (factor + 1);
+	}
+
+	int ITagged.Tag {
+		get { return Flags * 3; }
+	}
+}
+
+class Circle : Shape {
+	public double R;
+	public Line Diameter;
+	public static readonly double Tau;
+	public static Circle Unit;
+
+	static Circle ()
+	{
+		Tau = 2 * Math.PI;
+		Unit = new Circle (1);
+	}
+
+	public Circle (double r) : base ("circle")
+	{
+		R = r;
+		Diameter.From = new Point (0, 0);
+		Diameter.To = new Point ((int) r * 2, 0);
+		Diameter.Label = "d" + r;
+	}
+
+	public override double Area ()
+	{
+		return Tau * R * R / 2;
+	}
+}
+
+class Tracked {
+	public static int Finalized;
+	public object Payload;
+	public long Stamp;
+
+	public Tracked (int i)
+	{
+		Payload = new int [] { i, i + 1 };
+		Stamp = i * 1000L;
+	}
+
+	~Tracked ()
+	{
+		Finalized ++;
+	}
+}
+
+class Node {
+	public Node Next;
+	public Point At;
+	public string Text;
+	public Overlay Bits;
+	public Packed Small;
+}
+
+class Counters {
+	[ThreadStatic]
+	public static int PerThread;
+	public static int Shared;
+	public const int Limit = 10;
+}
+
+class Program {
+	static Node Build (int count)
+	{
+		Node head = null;
+		for (int i = 0; i < count; i++) {
+			Node n = new Node ();
+			n.Next = head;
+			n.At = new Point (i, -i);
+			n.Text = "node" + i;
+			n.Bits.Wide = 0x0102030405060708L * i;
+			n.Bits.Real = i / 4.0;
+			n.Small.A = (byte) i;
+			n.Small.B = i * 7;
+			n.Small.C = (short) -i;
+			head = n;
+		}
+		return head;
+	}
+
+	static void MakeGarbage ()
+	{
+		for (int i = 0; i < 100; i++)
+			new Tracked (i);
+	}
+
+	static int Main ()
+	{
+		IShape [] shapes = new IShape [] { new Rect (2, 3), new Square (4), new Circle (1.5), Circle.Unit };
+		foreach (IShape s in shapes) {
+			IScalable sc = s as IScalable;
+			if (sc != null)
+				sc.Scale (2);
+			ITagged t = s as ITagged;
+			Console.WriteLine ("{0} area={1:F3} tag={2}", s.Name, s.Area (), t == null ? -1 : t.Tag);
+		}
+		Rect r = (Rect) shapes [0];
+		Console.WriteLine ("rect {0} {1} {2} {3}", r.W, r.H, r.Owner, r.Origin);
+		Square sq = (Square) shapes [1];
+		Console.WriteLine ("square {0} {1} {2} {3}", sq.W, sq.Flags, sq.Note, sq.Id);
+		Circle c = (Circle) shapes [2];
+		Console.WriteLine ("circle {0} {1} {2} {3}", c.R, c.Diameter.From, c.Diameter.To, c.Diameter.Label);
+		Console.WriteLine ("created {0}", Shape.Created);
+
+		// Keep references only in fields of the objects, so a wrong GC descriptor loses them
+		Node head = Build (2000);
+		MakeGarbage ();
+		GC.Collect ();
+		GC.WaitForPendingFinalizers ();
+		GC.Collect ();
+		long sum = 0;
+		int count = 0;
+		for (Node n = head; n != null; n = n.Next) {
+			sum += n.At.X + n.At.Y + n.Text.Length + n.Bits.Low + (long) n.Bits.Real + n.Small.A + n.Small.B + n.Small.C;
+			count ++;
+		}
+		Console.WriteLine ("nodes {0} {1}", count, sum);
+		Console.WriteLine ("finalized {0}", Tracked.Finalized > 0);
+
+		Overlay o = new Overlay ();
+		o.Wide = 0x1122334455667788L;
+		Console.WriteLine ("overlay {0:X} size {1} packed {2}", o.Low, Marshal.SizeOf (typeof (Overlay)), Marshal.SizeOf (typeof (Packed)));
+
+		Counters.PerThread = 5;
+		Counters.Shared = 6;
+		Console.WriteLine ("statics {0} {1} {2}", Counters.PerThread, Counters.Shared, Counters.Limit);
+		return 0;
+	}
+}